@@ -1,7 +1,9 @@
 #pragma once
 
+#include <algorithm>
 #include <cstring>
 #include <stdexcept>
+#include <utility>
 
 #include "IEnumerable.h"
 #include "IEnumerator.h"
@@ -13,6 +15,7 @@ template <class T> class DynamicArray : public IEnumerable<T> {
     DynamicArray(T *items, int count);
     DynamicArray(int size);
     DynamicArray(const DynamicArray<T> &dynamicArray);
+    DynamicArray(DynamicArray<T> &&dynamicArray);
     DynamicArray(int size, const DynamicArray<T> &dynamicArray);
     virtual ~DynamicArray();
     T get(int index) const;
@@ -22,6 +25,7 @@ template <class T> class DynamicArray : public IEnumerable<T> {
     T &operator[](int index);
     T &operator[](const int &index) const;
     PATypes::DynamicArray<T> &operator=(const DynamicArray<T> &array);
+    PATypes::DynamicArray<T> &operator=(DynamicArray<T> &&array);
     IEnumerator<T> *getEnumerator() { return new Enumerator(*this); }
 
   private:
@@ -36,15 +40,15 @@ template <class T> class DynamicArray : public IEnumerable<T> {
         virtual ~Enumerator() {}
 
         virtual bool moveNext() {
+            if (isFirst) {
+                isFirst = false;
+                return parent.getSize() > 0;
+            }
             if (ptr - parent.items >= parent.getSize() - 1 ||
                 (ptr - parent.items) < 0) {
                 return 0;
             }
-            if (isFirst) {
-                isFirst = false;
-            } else {
-                ++ptr;
-            }
+            ++ptr;
             return 1;
         }
 
@@ -61,12 +65,16 @@ template <class T> class DynamicArray : public IEnumerable<T> {
     };
     T *items;
     int size;
+    // resize растит буфер геометрически, поэтому append в ArraySequence
+    // амортизированно O(1) и не копирует элементы на каждой вставке
+    int capacity;
 };
 
 } // namespace PATypes
 
 template <class T>
-PATypes::DynamicArray<T>::DynamicArray(T *items, int count) : size(count) {
+PATypes::DynamicArray<T>::DynamicArray(T *items, int count)
+    : size(count), capacity(count) {
     this->items = new T[this->size];
     for (int i = 0; i < this->size; ++i) {
         this->items[i] = (items[i]);
@@ -74,7 +82,8 @@ PATypes::DynamicArray<T>::DynamicArray(T *items, int count) : size(count) {
 }
 
 template <class T>
-PATypes::DynamicArray<T>::DynamicArray(int size) : size(size) {
+PATypes::DynamicArray<T>::DynamicArray(int size)
+    : size(size), capacity(size) {
     this->items = new T[size];
     for (int i = 0; i < size; ++i) {
         this->items[i] = T();
@@ -83,17 +92,23 @@ PATypes::DynamicArray<T>::DynamicArray(int size) : size(size) {
 
 template <class T>
 PATypes::DynamicArray<T>::DynamicArray(const DynamicArray<T> &dynamicArray)
-    : size(dynamicArray.size) {
+    : size(dynamicArray.size), capacity(dynamicArray.size) {
     this->items = new T[this->size];
     for (int i = 0; i < size; ++i) {
         this->items[i] = T(dynamicArray[i]);
     }
 }
 
+template <class T>
+PATypes::DynamicArray<T>::DynamicArray(DynamicArray<T> &&dynamicArray)
+    : items(std::exchange(dynamicArray.items, nullptr)),
+      size(std::exchange(dynamicArray.size, 0)),
+      capacity(std::exchange(dynamicArray.capacity, 0)) {}
+
 template <class T>
 PATypes::DynamicArray<T>::DynamicArray(int size,
                                        const DynamicArray<T> &dynamicArray)
-    : size(size) {
+    : size(size), capacity(size) {
     this->items = new T[size];
     for (int i = 0; i < dynamicArray.size; ++i) {
         this->items[i] = T(dynamicArray[i]);
@@ -114,17 +129,25 @@ template <class T> int PATypes::DynamicArray<T>::getSize() {
 }
 
 template <class T> void PATypes::DynamicArray<T>::set(int index, T value) {
-    this->items[index] = value;
+    this->items[index] = std::move(value);
 }
 
 template <class T> void PATypes::DynamicArray<T>::resize(int newSize) {
-    T *newItems = new T[newSize];
-    for (int i = 0; i < size; ++i) {
-        newItems[i] = T(items[i]);
+    if (newSize > this->capacity) {
+        int newCapacity = std::max(newSize, this->capacity * 2);
+        T *newItems = new T[newCapacity];
+        for (int i = 0; i < size; ++i) {
+            newItems[i] = std::move(items[i]);
+        }
+        delete[] this->items;
+        this->items = newItems;
+        this->capacity = newCapacity;
+    } else {
+        for (int i = newSize; i < size; ++i) {
+            this->items[i] = T();
+        }
     }
     this->size = newSize;
-    delete[] this->items;
-    this->items = newItems;
 }
 
 template <class T> T &PATypes::DynamicArray<T>::operator[](int index) {
@@ -145,12 +168,28 @@ T &PATypes::DynamicArray<T>::operator[](const int &index) const {
 template <class T>
 PATypes::DynamicArray<T> &
 PATypes::DynamicArray<T>::operator=(const PATypes::DynamicArray<T> &array) {
+    if (this == &array)
+        return *this;
     if (this->items)
         delete[] this->items;
     this->size = array.size;
+    this->capacity = array.size;
     this->items = new T[this->size];
     for (int i = 0; i < size; ++i) {
         this->items[i] = T(array[i]);
     }
     return *this;
 }
+
+template <class T>
+PATypes::DynamicArray<T> &
+PATypes::DynamicArray<T>::operator=(PATypes::DynamicArray<T> &&array) {
+    if (this == &array)
+        return *this;
+    if (this->items)
+        delete[] this->items;
+    this->items = std::exchange(array.items, nullptr);
+    this->size = std::exchange(array.size, 0);
+    this->capacity = std::exchange(array.capacity, 0);
+    return *this;
+}
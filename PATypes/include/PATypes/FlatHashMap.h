@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "DynamicArray.h"
+#include "IMap.h"
+
+namespace PATypes {
+// Хэш строк, по которому FlatHashMap<std::string, V, StringHash,
+// std::equal_to<>> ищет и по std::string_view / const char * без
+// построения std::string
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view key) const {
+        return std::hash<std::string_view>{}(key);
+    }
+};
+
+// Хэш-таблица с открытой адресацией: пары лежат подряд в одном массиве,
+// коллизии разрешаются линейным пробированием. Когда таблица заполнена
+// больше чем на 3/4, она удваивается. Удаление сдвигает хвост цепочки
+// назад, поэтому «надгробий» нет и поиск не деградирует со временем.
+// Отсутствие ключа сообщается через Find/TryGet без исключений; Get
+// по-прежнему бросает std::out_of_range, как того требует IMap.
+// Если Hash и Equal объявляют is_transparent, Find/TryGet/ContainsKey
+// принимают ключ любого сравнимого с K типа.
+template <class K, class V, class Hash = std::hash<K>,
+          class Equal = std::equal_to<K>>
+class FlatHashMap : IMap<K, V> {
+    struct Slot {
+        K key;
+        V value;
+        bool used = false;
+    };
+    DynamicArray<Slot> slots;
+    int capacity;
+    int count;
+    // номер начального слота — старшие биты хэша, умноженного на 2^64/φ:
+    // так тождественный std::hash<int> не собирает кратные ключи в кучу
+    int shift;
+    Hash hash;
+    Equal equal;
+
+    static constexpr int MinCapacity = 16;
+
+    template <class Q>
+    static constexpr bool IsLookupKey =
+        std::is_convertible_v<const Q &, const K &> ||
+        (requires { typename Hash::is_transparent; } &&
+         requires { typename Equal::is_transparent; });
+
+    template <class Q> int Home(const Q &key) const {
+        return (int)(((uint64_t)hash(key) * 0x9E3779B97F4A7C15ull) >> shift);
+    }
+
+    template <class Q> int FindIndex(const Q &key) const {
+        if (!count)
+            return -1;
+        for (int i = Home(key);; i = (i + 1) & (capacity - 1)) {
+            const Slot &slot = slots[i];
+            if (!slot.used)
+                return -1;
+            if (equal(slot.key, key))
+                return i;
+        }
+    }
+
+    void Rehash(int newCapacity) {
+        DynamicArray<Slot> old(std::move(slots));
+        int oldCapacity = capacity;
+        slots = DynamicArray<Slot>(newCapacity);
+        capacity = newCapacity;
+        shift = 64;
+        for (int c = capacity; c > 1; c >>= 1) {
+            --shift;
+        }
+        for (int i = 0; i < oldCapacity; ++i) {
+            Slot &slot = old[i];
+            if (!slot.used)
+                continue;
+            int j = Home(slot.key);
+            while (slots[j].used) {
+                j = (j + 1) & (capacity - 1);
+            }
+            slots[j] = std::move(slot);
+        }
+    }
+
+    // Слот для key: найденный или свободный, куда key встанет
+    int Place(const K &key) {
+        if ((count + 1) * 4 > capacity * 3)
+            Rehash(capacity * 2);
+        int i = Home(key);
+        while (slots[i].used && !equal(slots[i].key, key)) {
+            i = (i + 1) & (capacity - 1);
+        }
+        return i;
+    }
+
+  public:
+    FlatHashMap(int expected = 0)
+        : slots(0), capacity(0), count(0), shift(64) {
+        int initial = MinCapacity;
+        while (initial * 3 < expected * 4) {
+            initial *= 2;
+        }
+        Rehash(initial);
+    }
+
+    int GetCount() const { return count; }
+    int GetCapacity() const { return capacity; }
+
+    // Готовит таблицу к expected элементам без промежуточных удвоений
+    void Reserve(int expected) {
+        int newCapacity = capacity;
+        while (newCapacity * 3 < expected * 4) {
+            newCapacity *= 2;
+        }
+        if (newCapacity != capacity)
+            Rehash(newCapacity);
+    }
+
+    virtual void Add(K key, V value) {
+        int i = Place(key);
+        if (!slots[i].used) {
+            slots[i].key = std::move(key);
+            slots[i].used = true;
+            ++count;
+        }
+        slots[i].value = std::move(value);
+    }
+
+    // Значение по ключу; отсутствующий ключ вставляется со значением V()
+    V &operator[](const K &key) {
+        int i = Place(key);
+        if (!slots[i].used) {
+            slots[i].key = key;
+            slots[i].value = V();
+            slots[i].used = true;
+            ++count;
+        }
+        return slots[i].value;
+    }
+
+    template <class Q = K>
+        requires IsLookupKey<Q>
+    V *Find(const Q &key) {
+        int i = FindIndex(key);
+        return i < 0 ? nullptr : &slots[i].value;
+    }
+    template <class Q = K>
+        requires IsLookupKey<Q>
+    const V *Find(const Q &key) const {
+        int i = FindIndex(key);
+        return i < 0 ? nullptr : &slots[i].value;
+    }
+
+    template <class Q = K>
+        requires IsLookupKey<Q>
+    bool TryGet(const Q &key, V &value) const {
+        const V *found = Find(key);
+        if (found)
+            value = *found;
+        return found;
+    }
+
+    template <class Q = K>
+        requires IsLookupKey<Q>
+    bool ContainsKey(const Q &key) const {
+        return FindIndex(key) >= 0;
+    }
+
+    virtual V Get(K key) const {
+        const V *found = Find(key);
+        if (!found)
+            throw std::out_of_range(
+                "попытка найти элемент, не лежащий в FlatHashMap");
+        return *found;
+    }
+
+    virtual void Delete(K key) {
+        int hole = FindIndex(key);
+        if (hole < 0)
+            return;
+        // сдвигаем назад элементы, чей начальный слот не между дыркой и ними
+        for (int i = (hole + 1) & (capacity - 1); slots[i].used;
+             i = (i + 1) & (capacity - 1)) {
+            int home = Home(slots[i].key);
+            bool staysAfterHole = hole < i ? (hole < home && home <= i)
+                                           : (hole < home || home <= i);
+            if (staysAfterHole)
+                continue;
+            slots[hole] = std::move(slots[i]);
+            hole = i;
+        }
+        slots[hole] = Slot();
+        --count;
+    }
+
+    virtual void Clear() {
+        slots = DynamicArray<Slot>(capacity);
+        count = 0;
+    }
+
+    // f(key, value) для всех пар в порядке слотов
+    template <class F> void ForEach(F &&f) const {
+        for (int i = 0; i < capacity; ++i) {
+            const Slot &slot = slots[i];
+            if (slot.used)
+                f(slot.key, slot.value);
+        }
+    }
+};
+} // namespace PATypes
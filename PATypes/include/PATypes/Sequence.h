@@ -55,6 +55,8 @@ template <class T> class ArraySequence : public Sequence<T> {
     ArraySequence() : array(0) {};
     ArraySequence(const ArraySequence &arraySequence)
         : array(arraySequence.array) {};
+    ArraySequence(ArraySequence &&arraySequence)
+        : array(std::move(arraySequence.array)) {};
     ArraySequence(Sequence<T> &sequence);
     ArraySequence(T item) : array(&item, 1) {}
     ArraySequence(size_t size) : array(size) {}
@@ -75,7 +77,7 @@ template <class T> class ArraySequence : public Sequence<T> {
     }
     T operator[](int index);
     ArraySequence<T> &operator=(const ArraySequence<T> &other);
-    ArraySequence<T> &operator=(const ArraySequence<T> &&other);
+    ArraySequence<T> &operator=(ArraySequence<T> &&other);
     virtual IEnumerator<T> *getEnumerator() { return array.getEnumerator(); }
 
   protected:
@@ -110,7 +112,7 @@ template <class T> int ArraySequence<T>::getLength() { return array.getSize(); }
 template <class T> Sequence<T> *ArraySequence<T>::append(T item) {
     ArraySequence<T> *current = Instance();
     current->array.resize(array.getSize() + 1);
-    current->array.set(array.getSize() - 1, item);
+    current->array.set(array.getSize() - 1, std::move(item));
     return current;
 }
 
@@ -173,8 +175,8 @@ ArraySequence<T> &ArraySequence<T>::operator=(const ArraySequence<T> &other) {
 }
 
 template <class T>
-ArraySequence<T> &ArraySequence<T>::operator=(const ArraySequence<T> &&other) {
-    this->array = DynamicArray<T>(other.array);
+ArraySequence<T> &ArraySequence<T>::operator=(ArraySequence<T> &&other) {
+    this->array = std::move(other.array);
     return *this;
 }
 
@@ -5,10 +5,13 @@ extern "C" {
 #include <libavformat/avformat.h>
 #include <libavutil/mathematics.h>
 }
+#include <stdexcept>
 #include <string>
 
+/* thread_count = 0 lets libavcodec pick one thread per core */
 static int open_codec_context(const std::string& filename, int *stream_idx,
-                              AVCodecContext **dec_ctx, AVFormatContext *fmt_ctx, enum AVMediaType type)
+                              AVCodecContext **dec_ctx, AVFormatContext *fmt_ctx, enum AVMediaType type,
+                              int thread_count = 1, int thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE)
 {
     int ret, stream_index;
     AVStream *st;
@@ -46,6 +49,10 @@ static int open_codec_context(const std::string& filename, int *stream_idx,
             return ret;
         }
  
+        /* Frame and slice threading; the decoder uses whichever it supports */
+        (*dec_ctx)->thread_count = thread_count;
+        (*dec_ctx)->thread_type = thread_type;
+
         /* Init the decoders */
         if ((ret = avcodec_open2(*dec_ctx, dec, NULL)) < 0) {
             fprintf(stderr, "Failed to open %s codec\n",
@@ -57,3 +64,156 @@ static int open_codec_context(const std::string& filename, int *stream_idx,
  
     return 0;
 }
+
+namespace CCTV {
+// Первая плоскость кадра в этом формате — 8-битная яркость Y с шагом
+// строки linesize[0], её можно брать без преобразования
+inline bool HasLumaPlane(int format) {
+    switch (format) {
+    case AV_PIX_FMT_GRAY8:
+    case AV_PIX_FMT_YUV420P:
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_YUV422P:
+    case AV_PIX_FMT_YUVJ422P:
+    case AV_PIX_FMT_YUV444P:
+    case AV_PIX_FMT_YUVJ444P:
+    case AV_PIX_FMT_YUV440P:
+    case AV_PIX_FMT_YUVJ440P:
+    case AV_PIX_FMT_YUV410P:
+    case AV_PIX_FMT_YUV411P:
+    case AV_PIX_FMT_YUVA420P:
+    case AV_PIX_FMT_NV12:
+    case AV_PIX_FMT_NV21:
+    case AV_PIX_FMT_NV16:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Демультиплексирование и декодирование видеопотока файла кадр за кадром.
+// Next() возвращает очередной декодированный кадр в формате декодера;
+// кадр принадлежит декодеру и действителен до следующего вызова Next().
+// decodeThreads — число потоков декодера, 0 — по числу ядер.
+class VideoDecoder {
+    AVFormatContext *fmt_ctx = NULL;
+    AVCodecContext *dec_ctx = NULL;
+    AVPacket *pkt = NULL;
+    AVFrame *frame = NULL;
+    int streamIndex = -1;
+    bool flushing = false;
+    bool finished = false;
+    double position = 0;
+
+    void Release() {
+        av_frame_free(&frame);
+        av_packet_free(&pkt);
+        avcodec_free_context(&dec_ctx);
+        avformat_close_input(&fmt_ctx);
+    }
+
+  public:
+    VideoDecoder(const std::string &filename, int decodeThreads = 0) {
+        pkt = av_packet_alloc();
+        frame = av_frame_alloc();
+        if (!pkt || !frame ||
+            avformat_open_input(&fmt_ctx, filename.c_str(), NULL, NULL) < 0 ||
+            avformat_find_stream_info(fmt_ctx, NULL) < 0 ||
+            open_codec_context(filename, &streamIndex, &dec_ctx, fmt_ctx,
+                               AVMEDIA_TYPE_VIDEO, decodeThreads) < 0) {
+            Release();
+            throw std::logic_error("Ошибка при загрузке видео");
+        }
+    }
+    VideoDecoder(const VideoDecoder &) = delete;
+    VideoDecoder &operator=(const VideoDecoder &) = delete;
+    ~VideoDecoder() { Release(); }
+
+    int GetWidth() const { return dec_ctx->width; }
+    int GetHeight() const { return dec_ctx->height; }
+    enum AVPixelFormat GetPixelFormat() const { return dec_ctx->pix_fmt; }
+    // фактическое число потоков после открытия декодера
+    int GetDecodeThreads() const {
+        return dec_ctx->active_thread_type ? dec_ctx->thread_count : 1;
+    }
+    const char *GetDecodeThreadType() const {
+        if (dec_ctx->active_thread_type & FF_THREAD_FRAME)
+            return "кадровая";
+        if (dec_ctx->active_thread_type & FF_THREAD_SLICE)
+            return "по слайсам";
+        return "нет";
+    }
+    float GetFramerate() const {
+        if (dec_ctx->framerate.num <= 0 || dec_ctx->framerate.den <= 0)
+            return 0;
+        return (float)dec_ctx->framerate.num / dec_ctx->framerate.den;
+    }
+    // длительность видеопотока в секундах, 0 — неизвестна
+    double GetDuration() const {
+        AVStream *stream = fmt_ctx->streams[streamIndex];
+        if (stream->duration != AV_NOPTS_VALUE && stream->duration > 0)
+            return stream->duration * av_q2d(stream->time_base);
+        if (fmt_ctx->duration != AV_NOPTS_VALUE && fmt_ctx->duration > 0)
+            return (double)fmt_ctx->duration / AV_TIME_BASE;
+        return 0;
+    }
+    // время последнего кадра от начала потока в секундах
+    double GetPosition() const { return position; }
+
+    // nullptr — поток закончился (или декодирование прервано ошибкой)
+    const AVFrame *Next() {
+        av_frame_unref(frame);
+        while (!finished) {
+            int ret = avcodec_receive_frame(dec_ctx, frame);
+            if (ret >= 0) {
+                AVStream *stream = fmt_ctx->streams[streamIndex];
+                int64_t timestamp = frame->best_effort_timestamp;
+                if (timestamp != AV_NOPTS_VALUE) {
+                    if (stream->start_time != AV_NOPTS_VALUE)
+                        timestamp -= stream->start_time;
+                    position = timestamp * av_q2d(stream->time_base);
+                }
+                return frame;
+            }
+            if (ret == AVERROR_EOF) {
+                finished = true;
+                break;
+            }
+            if (ret != AVERROR(EAGAIN)) {
+                fprintf(stderr, "Error during decoding (%s)\n",
+                        av_err2str(ret));
+                finished = true;
+                break;
+            }
+            if (flushing) {
+                finished = true;
+                break;
+            }
+
+            // декодеру нужен следующий пакет нашего потока
+            while (true) {
+                if (av_read_frame(fmt_ctx, pkt) < 0) {
+                    // конец файла: выталкиваем задержанные декодером кадры
+                    flushing = true;
+                    avcodec_send_packet(dec_ctx, NULL);
+                    break;
+                }
+                if (pkt->stream_index != streamIndex) {
+                    av_packet_unref(pkt);
+                    continue;
+                }
+                ret = avcodec_send_packet(dec_ctx, pkt);
+                av_packet_unref(pkt);
+                if (ret < 0) {
+                    fprintf(stderr,
+                            "Error submitting a packet for decoding (%s)\n",
+                            av_err2str(ret));
+                    finished = true;
+                }
+                break;
+            }
+        }
+        return nullptr;
+    }
+};
+} // namespace CCTV
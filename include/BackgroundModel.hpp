@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <PATypes/DynamicArray.h>
+
+#include "PixelKernels.hpp"
+#include "RegionMask.hpp"
+
+namespace CCTV {
+namespace BackgroundKernels {
+// Обновление фона на месте за один проход: каждое ядро возвращает сумму
+// модулей разностей кадра и фона до обновления и тут же сдвигает фон к
+// кадру. Скалярный и SIMD-варианты дают одно и то же бит в бит.
+
+// Скользящее среднее в фиксированной точке Q7 (int16, фон * 128):
+// bg += ((p << 7) - bg) >> shift, то есть alpha = 2^-shift. Разность
+// укладывается в int16, сдвиг арифметический, как у psraw.
+inline uint64_t UpdateAverageScalar(const unsigned char *pixels,
+                                    int16_t *background, size_t n, int shift) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int value = (background[i] + 64) >> 7;
+        result += (unsigned)std::abs((int)pixels[i] - value);
+        background[i] += ((pixels[i] << 7) - background[i]) >> shift;
+    }
+    return result;
+}
+
+// Приближение скользящей медианы: фон шагает к кадру не больше чем на
+// step уровней за кадр и не перескакивает его
+inline uint64_t UpdateMedianScalar(const unsigned char *pixels,
+                                   unsigned char *background, size_t n,
+                                   int step) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int diff = (int)pixels[i] - background[i];
+        result += (unsigned)std::abs(diff);
+        background[i] += std::clamp(diff, -step, step);
+    }
+    return result;
+}
+
+#ifdef CCTV_X86_KERNELS
+__attribute__((target("sse2"))) inline uint64_t
+UpdateAverageSSE2(const unsigned char *pixels, int16_t *background, size_t n,
+                  int shift) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i half = _mm_set1_epi16(64);
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(pixels + i));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(background + i));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(background + i + 8));
+        __m128i value = _mm_packus_epi16(
+            _mm_srli_epi16(_mm_add_epi16(b0, half), 7),
+            _mm_srli_epi16(_mm_add_epi16(b1, half), 7));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(p, value));
+        __m128i p0 = _mm_slli_epi16(_mm_unpacklo_epi8(p, zero), 7);
+        __m128i p1 = _mm_slli_epi16(_mm_unpackhi_epi8(p, zero), 7);
+        b0 = _mm_add_epi16(b0, _mm_sra_epi16(_mm_sub_epi16(p0, b0), count));
+        b1 = _mm_add_epi16(b1, _mm_sra_epi16(_mm_sub_epi16(p1, b1), count));
+        _mm_storeu_si128((__m128i *)(background + i), b0);
+        _mm_storeu_si128((__m128i *)(background + i + 8), b1);
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] +
+           UpdateAverageScalar(pixels + i, background + i, n - i, shift);
+}
+
+// Без знакового сравнения байтов: шаги вверх и вниз — насыщающие
+// разности, обрезанные до step
+__attribute__((target("sse2"))) inline uint64_t
+UpdateMedianSSE2(const unsigned char *pixels, unsigned char *background,
+                 size_t n, int step) {
+    const __m128i limit = _mm_set1_epi8((char)step);
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i *)(pixels + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(background + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(p, b));
+        __m128i up = _mm_min_epu8(_mm_subs_epu8(p, b), limit);
+        __m128i down = _mm_min_epu8(_mm_subs_epu8(b, p), limit);
+        _mm_storeu_si128((__m128i *)(background + i),
+                         _mm_sub_epi8(_mm_add_epi8(b, up), down));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] +
+           UpdateMedianScalar(pixels + i, background + i, n - i, step);
+}
+
+// 32 байта кадра за шаг; packus AVX2 склеивает половины по 128-битным
+// полосам, permute4x64 возвращает байты фона в порядок кадра
+__attribute__((target("avx2"))) inline uint64_t
+UpdateAverageAVX2(const unsigned char *pixels, int16_t *background, size_t n,
+                  int shift) {
+    const __m256i half = _mm256_set1_epi16(64);
+    const __m128i count = _mm_cvtsi32_si128(shift);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i p = _mm256_loadu_si256((const __m256i *)(pixels + i));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(background + i));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(background + i + 16));
+        __m256i value = _mm256_permute4x64_epi64(
+            _mm256_packus_epi16(
+                _mm256_srli_epi16(_mm256_add_epi16(b0, half), 7),
+                _mm256_srli_epi16(_mm256_add_epi16(b1, half), 7)),
+            0xD8);
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(p, value));
+        __m256i p0 = _mm256_slli_epi16(
+            _mm256_cvtepu8_epi16(_mm256_castsi256_si128(p)), 7);
+        __m256i p1 = _mm256_slli_epi16(
+            _mm256_cvtepu8_epi16(_mm256_extracti128_si256(p, 1)), 7);
+        b0 = _mm256_add_epi16(
+            b0, _mm256_sra_epi16(_mm256_sub_epi16(p0, b0), count));
+        b1 = _mm256_add_epi16(
+            b1, _mm256_sra_epi16(_mm256_sub_epi16(p1, b1), count));
+        _mm256_storeu_si256((__m256i *)(background + i), b0);
+        _mm256_storeu_si256((__m256i *)(background + i + 16), b1);
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           UpdateAverageSSE2(pixels + i, background + i, n - i, shift);
+}
+
+__attribute__((target("avx2"))) inline uint64_t
+UpdateMedianAVX2(const unsigned char *pixels, unsigned char *background,
+                 size_t n, int step) {
+    const __m256i limit = _mm256_set1_epi8((char)step);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i p = _mm256_loadu_si256((const __m256i *)(pixels + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(background + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(p, b));
+        __m256i up = _mm256_min_epu8(_mm256_subs_epu8(p, b), limit);
+        __m256i down = _mm256_min_epu8(_mm256_subs_epu8(b, p), limit);
+        _mm256_storeu_si256((__m256i *)(background + i),
+                            _mm256_sub_epi8(_mm256_add_epi8(b, up), down));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           UpdateMedianSSE2(pixels + i, background + i, n - i, step);
+}
+#endif
+
+// AVX-512BW пользуется вариантами AVX2: ядро упирается в память
+inline uint64_t UpdateAverage(const unsigned char *pixels, int16_t *background,
+                              size_t n, int shift) {
+#ifdef CCTV_X86_KERNELS
+    PixelKernels::SimdLevel level = PixelKernels::GetSimdLevel();
+    if (level >= PixelKernels::SimdLevel::AVX2)
+        return UpdateAverageAVX2(pixels, background, n, shift);
+    if (level == PixelKernels::SimdLevel::SSE2)
+        return UpdateAverageSSE2(pixels, background, n, shift);
+#endif
+    return UpdateAverageScalar(pixels, background, n, shift);
+}
+
+inline uint64_t UpdateMedian(const unsigned char *pixels,
+                             unsigned char *background, size_t n, int step) {
+#ifdef CCTV_X86_KERNELS
+    PixelKernels::SimdLevel level = PixelKernels::GetSimdLevel();
+    if (level >= PixelKernels::SimdLevel::AVX2)
+        return UpdateMedianAVX2(pixels, background, n, step);
+    if (level == PixelKernels::SimdLevel::SSE2)
+        return UpdateMedianSSE2(pixels, background, n, step);
+#endif
+    return UpdateMedianScalar(pixels, background, n, step);
+}
+} // namespace BackgroundKernels
+
+enum class BackgroundKind {
+    // экспоненциальное скользящее среднее
+    RunningAverage,
+    // приближение скользящей медианы шагами к кадру
+    RunningMedian
+};
+
+// Модель фона сцены вместо цепочки Frame::AND по окну: буфер фона один на
+// последовательность, обновляется на месте ядрами BackgroundKernels, так
+// что кадр обходится в один проход и ни одной аллокации при любой длине
+// окна. Длина окна задаёт только скорость, с которой фон догоняет сцену:
+// у среднего alpha = 2^-floor(log2(windowLength)), у медианы шаг
+// max(1, 32 / windowLength) уровней за кадр. Первый кадр становится фоном
+// целиком. С маской RegionMask читаются и обновляются только её отрезки.
+class BackgroundModel {
+    BackgroundKind kind;
+    int windowLength;
+    int width, height, channels;
+    size_t frameCount;
+    // фон * 128 для среднего
+    PATypes::DynamicArray<int16_t> average;
+    // фон для медианы
+    PATypes::DynamicArray<unsigned char> median;
+
+    size_t GetSize() const { return (size_t)width * height * channels; }
+
+    uint64_t UpdateSpan(const unsigned char *pixels, size_t offset, size_t n) {
+        if (kind == BackgroundKind::RunningAverage)
+            return BackgroundKernels::UpdateAverage(
+                pixels + offset, &average[offset], n, GetShift());
+        return BackgroundKernels::UpdateMedian(pixels + offset,
+                                               &median[offset], n, GetStep());
+    }
+
+    void Init(const unsigned char *pixels, int width, int height,
+              int channels) {
+        this->width = width;
+        this->height = height;
+        this->channels = channels;
+        size_t size = GetSize();
+        if (kind == BackgroundKind::RunningAverage) {
+            average.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                average[i] = pixels[i] << 7;
+            }
+        } else {
+            median.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                median[i] = pixels[i];
+            }
+        }
+    }
+
+  public:
+    BackgroundModel(BackgroundKind kind = BackgroundKind::RunningAverage,
+                    int windowLength = 8)
+        : kind(kind), windowLength(std::max(1, windowLength)), width(0),
+          height(0), channels(0), frameCount(0), average(0), median(0) {}
+
+    BackgroundKind GetKind() const { return kind; }
+    int GetWindow() const { return windowLength; }
+    // сдвиг alpha среднего, 1..7
+    int GetShift() const {
+        return std::clamp((int)std::bit_width((unsigned)windowLength) - 1, 1,
+                          7);
+    }
+    // шаг медианы за кадр
+    int GetStep() const { return std::max(1, 32 / windowLength); }
+    // сколько кадров прошло через модель
+    size_t GetFrameCount() const { return frameCount; }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    int GetChannels() const { return channels; }
+
+    // Средний модуль разности кадра и фона до обновления (по маске — по её
+    // пикселям), затем фон сдвигается к кадру. Первый кадр и кадр другого
+    // размера начинают фон заново и дают 0.
+    double Update(const unsigned char *pixels, int width, int height,
+                  int channels, const RegionMask *mask = nullptr) {
+        ++frameCount;
+        if (frameCount == 1 || width != this->width ||
+            height != this->height || channels != this->channels) {
+            Init(pixels, width, height, channels);
+            return 0;
+        }
+        if (!mask) {
+            size_t size = GetSize();
+            return size ? (double)UpdateSpan(pixels, 0, size) /
+                              ((size_t)width * height)
+                        : 0;
+        }
+        if (mask->GetWidth() != width || mask->GetHeight() != height)
+            throw std::logic_error("маска не совпадает с кадром");
+        if (!mask->GetPixelCount())
+            return 0;
+        uint64_t sum = 0;
+        mask->ForEachSpan([&](int y, int from, int to) {
+            sum += UpdateSpan(pixels, ((size_t)y * width + from) * channels,
+                              (size_t)(to - from) * channels);
+        });
+        return (double)sum / mask->GetPixelCount();
+    }
+
+    // Текущий фон байтами, GetWidth() * GetHeight() * GetChannels()
+    void GetBackground(unsigned char *out) const {
+        size_t size = GetSize();
+        for (size_t i = 0; i < size; ++i) {
+            out[i] = kind == BackgroundKind::RunningAverage
+                         ? (average[i] + 64) >> 7
+                         : median[i];
+        }
+    }
+};
+} // namespace CCTV
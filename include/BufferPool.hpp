@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+#include <PATypes/DynamicArray.h>
+
+namespace CCTV {
+// Пул буферов пикселей одного размера. Освобождённый кадр возвращает
+// буфер в пул, и следующий кадр того же разрешения получает его без
+// обращения к аллокатору. Пул потокобезопасен: кадры создаются в потоке
+// декодирования, а уничтожаются в потоке анализа.
+class PixelBufferPool {
+    size_t bufferSize;
+    PATypes::DynamicArray<unsigned char *> freeBuffers;
+    int freeCount;
+    std::mutex mutex;
+
+  public:
+    // maxFree — сколько свободных буферов держать про запас
+    PixelBufferPool(size_t bufferSize, int maxFree = 16)
+        : bufferSize(bufferSize), freeBuffers(maxFree), freeCount(0) {}
+    PixelBufferPool(const PixelBufferPool &) = delete;
+    PixelBufferPool &operator=(const PixelBufferPool &) = delete;
+    ~PixelBufferPool() {
+        for (int i = 0; i < freeCount; ++i) {
+            std::free(freeBuffers[i]);
+        }
+    }
+
+    size_t GetBufferSize() const { return bufferSize; }
+
+    unsigned char *Acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (freeCount > 0)
+                return freeBuffers[--freeCount];
+        }
+        unsigned char *buffer = (unsigned char *)std::malloc(bufferSize);
+        if (!buffer && bufferSize)
+            throw std::bad_alloc();
+        return buffer;
+    }
+
+    void Release(unsigned char *buffer) {
+        if (!buffer)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (freeCount < freeBuffers.getSize()) {
+                freeBuffers[freeCount++] = buffer;
+                return;
+            }
+        }
+        std::free(buffer);
+    }
+};
+} // namespace CCTV
@@ -0,0 +1,451 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <istream>
+#include <stdexcept>
+#include <string>
+
+#include <PATypes/DynamicArray.h>
+#include <PATypes/Sequence.h>
+
+#include "IntegralImage.hpp"
+#include "PixelKernels.hpp"
+#include "ThreadPool.hpp"
+
+namespace CCTV {
+// Прямоугольник признака Хаара в координатах окна детектора
+struct HaarRect {
+    int x, y, width, height;
+    float weight;
+};
+
+// Признак Хаара: взвешенная сумма яркостей двух-трёх прямоугольников окна
+struct HaarFeature {
+    static constexpr int MaxRects = 3;
+    HaarRect rects[MaxRects];
+    int rectCount = 0;
+
+    // значение признака в окне с левым верхним углом (x, y) без
+    // масштабирования и нормировки, O(1) на прямоугольник
+    double Evaluate(const IntegralImage &image, int x, int y) const {
+        double result = 0;
+        for (int i = 0; i < rectCount; ++i) {
+            const HaarRect &r = rects[i];
+            result += r.weight *
+                      (double)image.RectSum(x + r.x, y + r.y, r.width, r.height);
+        }
+        return result;
+    }
+};
+
+// Решающий пень: признак, нормированный на площадь и стандартное
+// отклонение яркости окна, меньше threshold — голос left, иначе right
+struct HaarStump {
+    HaarFeature feature;
+    float threshold;
+    float left, right;
+};
+
+// Найденное окно в пикселях кадра
+struct Detection {
+    int x, y, width, height;
+};
+
+struct HaarDetectParams {
+    // во сколько раз растёт окно от масштаба к масштабу
+    float scaleFactor = 1.25f;
+    // шаг окна в долях исходного окна детектора: 0.1 — десятая часть
+    // ширины окна, но не меньше пикселя
+    float stepFraction = 0.1f;
+    // окна меньше этого размера не проверяются
+    int minWidth = 0;
+};
+
+// Каскад Виолы — Джонса: стадии решающих пней, окно отбрасывается на
+// первой стадии, сумма голосов которой не дотянула до порога стадии.
+// Так почти все окна отсеиваются парой признаков первых стадий.
+//
+// Текстовый формат FromStream (разделители — любые пробельные символы):
+//   ширина высота число_стадий
+//   для каждой стадии: число_пней порог_стадии
+//     для каждого пня: число_прямоугольников
+//       (x y ширина высота вес) для каждого прямоугольника
+//       порог left right
+class HaarCascade {
+    struct Stage {
+        int firstStump, stumpCount;
+        float threshold;
+    };
+
+    int windowWidth, windowHeight;
+    PATypes::DynamicArray<HaarStump> stumps;
+    int stumpCount;
+    PATypes::DynamicArray<Stage> stages;
+    int stageCount;
+
+  public:
+    // Каскад, пересчитанный под один масштаб окна и одно интегральное
+    // изображение: каждый прямоугольник — четыре смещения углов в таблице
+    // сумм, так что окно проверяется без умножений на координаты.
+    // Только читается, поэтому один экземпляр обходят все потоки.
+    class Scaled {
+        struct Rect {
+            int topLeft, topRight, bottomLeft, bottomRight;
+            float weight;
+        };
+        struct Stump {
+            int firstRect, rectCount;
+            float threshold, left, right;
+        };
+
+        const HaarCascade *cascade;
+        PATypes::DynamicArray<Rect> rects;
+        PATypes::DynamicArray<Stump> stumps;
+        int width, height;
+        int stride;
+        double invArea;
+
+        double Deviation(const uint32_t *s, const uint64_t *q) const {
+            int right = width, bottom = height * stride;
+            double sum = (double)(s[bottom + right] - s[bottom] - s[right] +
+                                  s[0]);
+            double sumSq = (double)(q[bottom + right] - q[bottom] -
+                                    q[right] + q[0]);
+            double mean = sum * invArea;
+            double variance = sumSq * invArea - mean * mean;
+            return variance > 1 ? std::sqrt(variance) : 1;
+        }
+
+      public:
+        Scaled()
+            : cascade(nullptr), rects(0), stumps(0), width(0), height(0),
+              stride(0), invArea(0) {}
+        Scaled(const HaarCascade &cascade, float scale, int stride)
+            : cascade(&cascade), rects(cascade.stumpCount * HaarFeature::MaxRects),
+              stumps(cascade.stumpCount),
+              width((int)(cascade.windowWidth * scale)),
+              height((int)(cascade.windowHeight * scale)), stride(stride),
+              invArea(1.0 / ((double)width * height)) {
+            int rectCount = 0;
+            for (int s = 0; s < cascade.stumpCount; ++s) {
+                const HaarStump &source = cascade.stumps[s];
+                const HaarFeature &feature = source.feature;
+                Stump &stump = stumps[s];
+                stump.firstRect = rectCount;
+                stump.rectCount = feature.rectCount;
+                stump.threshold = source.threshold;
+                stump.left = source.left;
+                stump.right = source.right;
+                double weightedArea = 0, scaledWeightedArea = 0;
+                for (int i = 0; i < feature.rectCount; ++i) {
+                    const HaarRect &r = feature.rects[i];
+                    int x = (int)(r.x * scale), y = (int)(r.y * scale);
+                    int w = std::max(1, (int)(r.width * scale));
+                    int h = std::max(1, (int)(r.height * scale));
+                    Rect &rect = rects[rectCount + i];
+                    rect.topLeft = y * stride + x;
+                    rect.topRight = rect.topLeft + w;
+                    rect.bottomLeft = rect.topLeft + h * stride;
+                    rect.bottomRight = rect.bottomLeft + w;
+                    rect.weight = r.weight;
+                    weightedArea += r.weight * r.width * r.height;
+                    if (i > 0)
+                        scaledWeightedArea += rect.weight * w * h;
+                }
+                // после округления площади прямоугольников меняются, и
+                // признак с нулевой суммой весов по площади начинает
+                // реагировать на среднюю яркость; первый прямоугольник
+                // снова уравновешивает остальные
+                Rect &first = rects[rectCount];
+                int firstArea = ((first.bottomLeft - first.topLeft) / stride) *
+                                (first.topRight - first.topLeft);
+                if (feature.rectCount > 1 && std::fabs(weightedArea) < 1e-6)
+                    first.weight = -scaledWeightedArea / firstArea;
+                rectCount += feature.rectCount;
+            }
+        }
+
+        int GetWidth() const { return width; }
+        int GetHeight() const { return height; }
+
+        // Номер стадии, отбросившей окно с левым верхним углом (x, y), или
+        // число стадий, если окно прошло весь каскад
+        int Evaluate(const uint32_t *sums, const uint64_t *squares, int x,
+                     int y) const {
+            int origin = y * stride + x;
+            const uint32_t *s = sums + origin;
+            double deviation = Deviation(s, squares + origin);
+            for (int k = 0; k < cascade->stageCount; ++k) {
+                const Stage &stage = cascade->stages[k];
+                double votes = 0;
+                for (int i = 0; i < stage.stumpCount; ++i) {
+                    const Stump &stump = stumps[stage.firstStump + i];
+                    double value = 0;
+                    for (int j = 0; j < stump.rectCount; ++j) {
+                        const Rect &r = rects[stump.firstRect + j];
+                        value += r.weight *
+                                 (double)(s[r.bottomRight] - s[r.bottomLeft] -
+                                          s[r.topRight] + s[r.topLeft]);
+                    }
+                    votes += value * invArea < stump.threshold * deviation
+                                 ? stump.left
+                                 : stump.right;
+                }
+                if (votes < stage.threshold)
+                    return k;
+            }
+            return cascade->stageCount;
+        }
+
+        // Можно ли считать суммы прямоугольников окна в знаковых 32-битных
+        // полосах: тогда и перевод в double совпадает со скалярным
+        bool CanBatch() const { return (double)width * height * 255 < 2147483648.0; }
+
+#ifdef CCTV_X86_KERNELS
+        // То же, что Evaluate, сразу для четырёх окон (x + i * step, y) в
+        // полосах AVX2: углы прямоугольников собираются gather, признаки
+        // и голоса считаются в double в том же порядке, что в Evaluate,
+        // так что результат совпадает побитно. Стадия считается, пока жива
+        // хоть одна полоса; stages[i] — стадия, отбросившая окно i.
+        __attribute__((target("avx2"))) void
+        Evaluate4(const uint32_t *sums, const uint64_t *squares, int x, int y,
+                  int step, int *stages) const {
+            int origin = y * stride + x;
+            const int *base = (const int *)sums;
+            __m128i origins = _mm_add_epi32(
+                _mm_set1_epi32(origin),
+                _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3),
+                                _mm_set1_epi32(step)));
+            alignas(32) double deviations[4];
+            for (int i = 0; i < 4; ++i) {
+                deviations[i] = Deviation(sums + origin + i * step,
+                                          squares + origin + i * step);
+                stages[i] = cascade->stageCount;
+            }
+            __m256d deviation = _mm256_load_pd(deviations);
+            __m256d scale = _mm256_set1_pd(invArea);
+            int alive = 0xF;
+            for (int k = 0; k < cascade->stageCount; ++k) {
+                const Stage &stage = cascade->stages[k];
+                __m256d votes = _mm256_setzero_pd();
+                for (int i = 0; i < stage.stumpCount; ++i) {
+                    const Stump &stump = stumps[stage.firstStump + i];
+                    __m256d value = _mm256_setzero_pd();
+                    for (int j = 0; j < stump.rectCount; ++j) {
+                        const Rect &r = rects[stump.firstRect + j];
+                        __m128i br = _mm_i32gather_epi32(
+                            base, _mm_add_epi32(origins, _mm_set1_epi32(r.bottomRight)), 4);
+                        __m128i bl = _mm_i32gather_epi32(
+                            base, _mm_add_epi32(origins, _mm_set1_epi32(r.bottomLeft)), 4);
+                        __m128i tr = _mm_i32gather_epi32(
+                            base, _mm_add_epi32(origins, _mm_set1_epi32(r.topRight)), 4);
+                        __m128i tl = _mm_i32gather_epi32(
+                            base, _mm_add_epi32(origins, _mm_set1_epi32(r.topLeft)), 4);
+                        __m128i rectSum = _mm_add_epi32(
+                            _mm_sub_epi32(_mm_sub_epi32(br, bl), tr), tl);
+                        value = _mm256_add_pd(
+                            value, _mm256_mul_pd(_mm256_set1_pd(r.weight),
+                                                 _mm256_cvtepi32_pd(rectSum)));
+                    }
+                    __m256d less = _mm256_cmp_pd(
+                        _mm256_mul_pd(value, scale),
+                        _mm256_mul_pd(_mm256_set1_pd(stump.threshold), deviation),
+                        _CMP_LT_OQ);
+                    votes = _mm256_add_pd(
+                        votes, _mm256_blendv_pd(_mm256_set1_pd(stump.right),
+                                                _mm256_set1_pd(stump.left), less));
+                }
+                int failed = _mm256_movemask_pd(_mm256_cmp_pd(
+                                 votes, _mm256_set1_pd(stage.threshold),
+                                 _CMP_LT_OQ)) &
+                             alive;
+                for (int i = 0; i < 4; ++i) {
+                    if (failed >> i & 1)
+                        stages[i] = k;
+                }
+                alive &= ~failed;
+                if (!alive)
+                    return;
+            }
+        }
+#endif
+    };
+
+    HaarCascade(int windowWidth = 24, int windowHeight = 24)
+        : windowWidth(windowWidth), windowHeight(windowHeight), stumps(0),
+          stumpCount(0), stages(0), stageCount(0) {
+        if (windowWidth <= 0 || windowHeight <= 0)
+            throw std::invalid_argument("пустое окно каскада");
+    }
+
+    int GetWindowWidth() const { return windowWidth; }
+    int GetWindowHeight() const { return windowHeight; }
+    int GetStageCount() const { return stageCount; }
+
+    // Новая стадия; следующие AddStump попадают в неё
+    void AddStage(float threshold) {
+        stages.resize(stageCount + 1);
+        stages[stageCount++] = Stage{stumpCount, 0, threshold};
+    }
+    void AddStump(const HaarStump &stump) {
+        if (!stageCount)
+            throw std::logic_error("пень добавляется до первой стадии");
+        if (stump.feature.rectCount < 1 ||
+            stump.feature.rectCount > HaarFeature::MaxRects)
+            throw std::invalid_argument("признак Хаара из 1–3 прямоугольников");
+        for (int i = 0; i < stump.feature.rectCount; ++i) {
+            const HaarRect &r = stump.feature.rects[i];
+            if (r.x < 0 || r.y < 0 || r.width <= 0 || r.height <= 0 ||
+                r.x + r.width > windowWidth || r.y + r.height > windowHeight)
+                throw std::invalid_argument("прямоугольник вне окна каскада");
+        }
+        stumps.resize(stumpCount + 1);
+        stumps[stumpCount++] = stump;
+        ++stages[stageCount - 1].stumpCount;
+    }
+
+    static HaarCascade FromStream(std::istream &input) {
+        int width, height, stageCount;
+        if (!(input >> width >> height >> stageCount) || stageCount < 0)
+            throw std::runtime_error("неверный заголовок каскада");
+        HaarCascade result(width, height);
+        for (int k = 0; k < stageCount; ++k) {
+            int stumpCount;
+            float threshold;
+            if (!(input >> stumpCount >> threshold) || stumpCount < 0)
+                throw std::runtime_error("неверная стадия каскада");
+            result.AddStage(threshold);
+            for (int i = 0; i < stumpCount; ++i) {
+                HaarStump stump;
+                HaarFeature &feature = stump.feature;
+                if (!(input >> feature.rectCount) || feature.rectCount < 1 ||
+                    feature.rectCount > HaarFeature::MaxRects)
+                    throw std::runtime_error("неверный признак каскада");
+                for (int j = 0; j < feature.rectCount; ++j) {
+                    HaarRect &r = feature.rects[j];
+                    if (!(input >> r.x >> r.y >> r.width >> r.height >>
+                          r.weight))
+                        throw std::runtime_error("неверный признак каскада");
+                }
+                if (!(input >> stump.threshold >> stump.left >> stump.right))
+                    throw std::runtime_error("неверный пень каскада");
+                result.AddStump(stump);
+            }
+        }
+        return result;
+    }
+    static HaarCascade FromFile(const std::string &filename) {
+        std::ifstream input(filename);
+        if (!input)
+            throw std::runtime_error("не удалось открыть каскад " + filename);
+        return FromStream(input);
+    }
+
+    // Сколько окон проверит Detect на изображении width x height
+    long long CountWindows(int width, int height,
+                           const HaarDetectParams &params = HaarDetectParams()) const {
+        long long result = 0;
+        for (float scale = 1;; scale *= params.scaleFactor) {
+            int w = (int)(windowWidth * scale), h = (int)(windowHeight * scale);
+            if (w > width || h > height)
+                break;
+            if (w < params.minWidth)
+                continue;
+            int step = std::max(1, (int)std::lround(params.stepFraction * w));
+            result += (long long)((width - w) / step + 1) *
+                      ((height - h) / step + 1);
+        }
+        return result;
+    }
+
+    // Все окна изображения, прошедшие каскад, по всем масштабам от
+    // исходного окна до размера изображения, по масштабам и строкам.
+    // С пулом масштабы режутся на полосы строк, и полосы всех масштабов
+    // разбираются потоками пула: мелкие масштабы с тысячами окон в
+    // строке и крупные с десятком перемешиваются и балансируются общим
+    // счётчиком ParallelFor. Порядок результата от числа потоков не
+    // зависит.
+    PATypes::MutableArraySequence<Detection>
+    Detect(const IntegralImage &image,
+           const HaarDetectParams &params = HaarDetectParams(),
+           ThreadPool *pool = nullptr) const {
+        struct Band {
+            int scale, step, yFrom, yTo;
+        };
+        // строк окна в полосе: достаточно мелко, чтобы на 1080p полос
+        // было в разы больше, чем потоков
+        constexpr int BandRows = 8;
+        if (params.scaleFactor <= 1)
+            throw std::invalid_argument("масштаб каскада должен расти");
+        PATypes::MutableArraySequence<Scaled> scales;
+        PATypes::MutableArraySequence<Band> bands;
+        for (float scale = 1;; scale *= params.scaleFactor) {
+            Scaled scaled(*this, scale, image.GetStride());
+            if (scaled.GetWidth() > image.GetWidth() ||
+                scaled.GetHeight() > image.GetHeight())
+                break;
+            if (scaled.GetWidth() < params.minWidth)
+                continue;
+            int step = std::max(
+                1, (int)std::lround(params.stepFraction * scaled.GetWidth()));
+            int yEnd = image.GetHeight() - scaled.GetHeight() + 1;
+            for (int y = 0; y < yEnd; y += BandRows * step) {
+                bands.append(Band{scales.getLength(), step, y,
+                                  std::min(yEnd, y + BandRows * step)});
+            }
+            scales.append(std::move(scaled));
+        }
+
+        const uint32_t *sums = image.GetSums();
+        const uint64_t *squares = image.GetSquares();
+        int imageWidth = image.GetWidth();
+        bool batched = PixelKernels::GetSimdLevel() >= PixelKernels::SimdLevel::AVX2;
+        PATypes::DynamicArray<PATypes::MutableArraySequence<Detection>> found(
+            bands.getLength());
+        auto scan = [&](int b) {
+            const Band &band = bands.Getrvalue(b);
+            const Scaled &scaled = scales.Getrvalue(band.scale);
+            PATypes::MutableArraySequence<Detection> &out = found[b];
+            int w = scaled.GetWidth(), h = scaled.GetHeight();
+            int step = band.step;
+            for (int y = band.yFrom; y < band.yTo; y += step) {
+                int x = 0;
+#ifdef CCTV_X86_KERNELS
+                if (batched && scaled.CanBatch()) {
+                    int stages[4];
+                    for (; x + 3 * step + w <= imageWidth; x += 4 * step) {
+                        scaled.Evaluate4(sums, squares, x, y, step, stages);
+                        for (int i = 0; i < 4; ++i) {
+                            if (stages[i] == stageCount)
+                                out.append(Detection{x + i * step, y, w, h});
+                        }
+                    }
+                }
+#endif
+                for (; x + w <= imageWidth; x += step) {
+                    if (scaled.Evaluate(sums, squares, x, y) == stageCount)
+                        out.append(Detection{x, y, w, h});
+                }
+            }
+        };
+        if (pool) {
+            pool->ParallelFor(0, bands.getLength(), scan);
+        } else {
+            for (int b = 0; b < bands.getLength(); ++b) {
+                scan(b);
+            }
+        }
+
+        PATypes::MutableArraySequence<Detection> result;
+        for (int b = 0; b < bands.getLength(); ++b) {
+            PATypes::MutableArraySequence<Detection> &part = found[b];
+            for (int i = 0; i < part.getLength(); ++i) {
+                result.append(part.Getrvalue(i));
+            }
+        }
+        return result;
+    }
+};
+} // namespace CCTV
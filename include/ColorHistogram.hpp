@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "Histogram.hpp"
+#include "PixelKernels.hpp"
+
+namespace CCTV {
+// Гистограмма с фиксированным числом корзин в плоском массиве
+template <int BinCount> class BinnedHistogram : public IHistogram<int, uint32_t> {
+  public:
+    static constexpr int Bins = BinCount;
+    uint32_t bins[BinCount];
+    uint32_t total;
+
+    BinnedHistogram() : total(0) { memset(bins, 0, sizeof(bins)); }
+
+    uint32_t GetFrequency(int bin) const { return bins[bin]; }
+    // доля пикселей в корзине, 0 для пустой гистограммы
+    double GetShare(int bin) const {
+        return total ? (double)bins[bin] / total : 0;
+    }
+    // средний номер корзины
+    double GetMean() const {
+        if (!total)
+            return 0;
+        uint64_t sum = 0;
+        for (int i = 0; i < BinCount; ++i) {
+            sum += (uint64_t)bins[i] * i;
+        }
+        return (double)sum / total;
+    }
+};
+
+// Яркость Y' по BT.601, 256 корзин
+using LumaHistogram = BinnedHistogram<256>;
+// RGB, квантованный до 16 уровней на канал: корзина (r >> 4) << 8 |
+// (g >> 4) << 4 | b >> 4
+using QuantizedRGBHistogram = BinnedHistogram<16 * 16 * 16>;
+// По 256 корзин на каждый из первых трёх каналов
+struct ChannelHistograms {
+    BinnedHistogram<256> channel[3];
+};
+
+// Подсчёт гистограмм по буферу пикселей с чередующимися каналами.
+// Соседние пиксели часто попадают в одну корзину, и инкременты одного
+// счётчика подряд ждут друг друга через память (store-to-load). Поэтому
+// пиксели раскладываются по нескольким независимым подгистограммам, а
+// в конце складываются. Яркость RGB24 считается блоками во временный
+// массив SIMD-ядром PixelKernels::lumaRGB.
+// Сам подсчёт скалярный: у SSE2/AVX2 нет scatter, а разбор инкрементов
+// с конфликтами корзин в регистрах дороже, чем в памяти. Его предел —
+// около одного инкремента за такт, так что по полному кадру 1080p
+// гистограмма стоит порядка миллисекунды на яркость и втрое больше на
+// три канала. Быстрее — только меньше пикселей: кадры яркости
+// (DecodeFormat::Luma) при масштабе анализа 1/2 считаются вчетверо
+// быстрее и без перевода в яркость.
+namespace HistogramKernels {
+constexpr int SubHistograms = 4;
+constexpr size_t LumaBlock = 1024;
+
+inline unsigned char Luma(unsigned char r, unsigned char g, unsigned char b) {
+    return (unsigned char)((77 * r + 150 * g + 29 * b + 128) >> 8);
+}
+
+inline void CountBytes(const unsigned char *values, size_t count,
+                       uint32_t (*sub)[256]) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        ++sub[0][values[i]];
+        ++sub[1][values[i + 1]];
+        ++sub[2][values[i + 2]];
+        ++sub[3][values[i + 3]];
+    }
+    for (; i < count; ++i) {
+        ++sub[0][values[i]];
+    }
+}
+
+// Добавляет яркости pixelCount пикселей в подгистограммы sub
+inline void CountLuma(const unsigned char *pixels, size_t pixelCount,
+                      int channels, uint32_t (*sub)[256]) {
+    if (channels == 1) {
+        CountBytes(pixels, pixelCount, sub);
+    } else if (channels < 3) {
+        unsigned char luma[LumaBlock];
+        for (size_t from = 0; from < pixelCount; from += LumaBlock) {
+            size_t count = std::min(LumaBlock, pixelCount - from);
+            for (size_t i = 0; i < count; ++i) {
+                luma[i] = pixels[(from + i) * channels];
+            }
+            CountBytes(luma, count, sub);
+        }
+    } else {
+        unsigned char luma[LumaBlock];
+        for (size_t from = 0; from < pixelCount; from += LumaBlock) {
+            size_t count = std::min(LumaBlock, pixelCount - from);
+            const unsigned char *p = pixels + from * channels;
+            if (channels == 3) {
+                PixelKernels::Kernels().lumaRGB(p, luma, count);
+            } else {
+                for (size_t i = 0; i < count; ++i) {
+                    luma[i] = Luma(p[i * channels], p[i * channels + 1],
+                                   p[i * channels + 2]);
+                }
+            }
+            CountBytes(luma, count, sub);
+        }
+    }
+}
+
+// Складывает подгистограммы в result
+inline void FoldLuma(uint32_t (*sub)[256], size_t pixelCount,
+                     LumaHistogram &result) {
+    result = LumaHistogram();
+    for (int bin = 0; bin < 256; ++bin) {
+        result.bins[bin] = sub[0][bin] + sub[1][bin] + sub[2][bin] + sub[3][bin];
+    }
+    result.total = pixelCount;
+}
+
+inline void ComputeLuma(const unsigned char *pixels, size_t pixelCount,
+                        int channels, LumaHistogram &result) {
+    uint32_t sub[SubHistograms][256] = {};
+    CountLuma(pixels, pixelCount, channels, sub);
+    FoldLuma(sub, pixelCount, result);
+}
+
+inline void ComputeChannels(const unsigned char *pixels, size_t pixelCount,
+                            int channels, ChannelHistograms &result) {
+    int counted = std::min(channels, 3);
+    uint32_t sub[SubHistograms][3][256] = {};
+    size_t i = 0;
+    if (channels == 3) {
+        // развёрнуто под RGB24: двенадцать независимых счётчиков за шаг
+        for (; i + SubHistograms <= pixelCount; i += SubHistograms) {
+            const unsigned char *p = pixels + i * 3;
+            ++sub[0][0][p[0]];
+            ++sub[0][1][p[1]];
+            ++sub[0][2][p[2]];
+            ++sub[1][0][p[3]];
+            ++sub[1][1][p[4]];
+            ++sub[1][2][p[5]];
+            ++sub[2][0][p[6]];
+            ++sub[2][1][p[7]];
+            ++sub[2][2][p[8]];
+            ++sub[3][0][p[9]];
+            ++sub[3][1][p[10]];
+            ++sub[3][2][p[11]];
+        }
+    }
+    for (; i + SubHistograms <= pixelCount; i += SubHistograms) {
+        for (int s = 0; s < SubHistograms; ++s) {
+            const unsigned char *p = pixels + (i + s) * channels;
+            for (int c = 0; c < counted; ++c) {
+                ++sub[s][c][p[c]];
+            }
+        }
+    }
+    for (; i < pixelCount; ++i) {
+        for (int c = 0; c < counted; ++c) {
+            ++sub[0][c][pixels[i * channels + c]];
+        }
+    }
+    result = ChannelHistograms();
+    for (int c = 0; c < counted; ++c) {
+        for (int bin = 0; bin < 256; ++bin) {
+            result.channel[c].bins[bin] = sub[0][c][bin] + sub[1][c][bin] +
+                                          sub[2][c][bin] + sub[3][c][bin];
+        }
+        result.channel[c].total = pixelCount;
+    }
+}
+
+inline void ComputeQuantizedRGB(const unsigned char *pixels, size_t pixelCount,
+                                int channels, QuantizedRGBHistogram &result) {
+    // две подгистограммы по 16 КиБ, чтобы вместе остаться в L1
+    constexpr int Bins = QuantizedRGBHistogram::Bins;
+    static_assert(Bins == 4096);
+    uint32_t sub[2][Bins] = {};
+    int g = channels >= 3 ? 1 : 0, b = channels >= 3 ? 2 : 0;
+    auto bin = [g, b](const unsigned char *p) {
+        return (p[0] >> 4) << 8 | (p[g] >> 4) << 4 | p[b] >> 4;
+    };
+    size_t i = 0;
+    for (; i + 2 <= pixelCount; i += 2) {
+        ++sub[0][bin(pixels + i * channels)];
+        ++sub[1][bin(pixels + (i + 1) * channels)];
+    }
+    if (i < pixelCount)
+        ++sub[0][bin(pixels + i * channels)];
+    result = QuantizedRGBHistogram();
+    for (int k = 0; k < Bins; ++k) {
+        result.bins[k] = sub[0][k] + sub[1][k];
+    }
+    result.total = pixelCount;
+}
+} // namespace HistogramKernels
+} // namespace CCTV
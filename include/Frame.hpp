@@ -1,11 +1,23 @@
 #pragma once
 
+#include <atomic>
+#include <cstring>
 #include <memory>
+#include <new>
 
+#include "BackgroundModel.hpp"
+#include "Classifier.hpp"
+#include "ColorHistogram.hpp"
 #include "Colorspaces.hpp"
-#include "Histogram.hpp"
+#include "HistogramScore.hpp"
+#include "MixtureModel.hpp"
+#include "PixelKernels.hpp"
+#include "Pyramid.hpp"
+#include "RegionMask.hpp"
 #include "Score.hpp"
-#include <PATypes/HashMap.h>
+#include "ScoreCache.hpp"
+#include "SlidingWindowScore.hpp"
+#include "TileGrid.hpp"
 #include <PATypes/PairTuple.h>
 #include <PATypes/Sequence.h>
 
@@ -21,6 +33,7 @@ extern "C" {
 }
 
 #include "AVHelper.hpp"
+#include "BufferPool.hpp"
 #include "Tags.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -53,331 +66,763 @@ class IGLTexture {
 };
 
 class Frame : public IFrame, ITagged, std::enable_shared_from_this<Frame> {
-    unsigned char *data;
+    // Пиксели общие для всех копий кадра: копирование только увеличивает
+    // счётчик ссылок, а отдельный буфер появляется при первой записи
+    // (copy-on-write). Последняя ссылка возвращает буфер в пул или free.
+    std::shared_ptr<unsigned char> data;
     int width, height, channels;
     std::shared_ptr<ITag> tag;
+    // откуда берутся буферы кадра; nullptr — malloc
+    std::shared_ptr<PixelBufferPool> pool;
+    // Гистограмма яркости, посчитанная при первом запросе: соседние пары
+    // кадров в режиме ScoreMode::LumaHistogram берут её отсюда, а не
+    // считают заново. Пары оцениваются параллельно, поэтому атомарно;
+    // сбрасывается при записи в пиксели.
+    mutable std::atomic<std::shared_ptr<const LumaHistogram>> lumaHistogram;
+    // Уменьшенная копия для анализа, см. GetDownscaled; так же, как
+    // гистограмма, строится один раз на кадр, хотя кадр входит в две пары
+    struct Downscaled;
+    mutable std::atomic<std::shared_ptr<const Downscaled>> downscaled;
+    // гистограмма яркости по маске, см. GetCachedLumaHistogram(mask)
+    struct MaskedHistogram;
+    mutable std::atomic<std::shared_ptr<const MaskedHistogram>> maskedHistogram;
+
+    void CheckMask(const RegionMask &mask) const {
+        if (mask.GetWidth() != width || mask.GetHeight() != height)
+            throw std::logic_error("маска не совпадает с кадром");
+    }
+    // Поточечные операции через IRGBColor читают по три байта на пиксель;
+    // у кадров яркости (DecodeFormat::Luma) байт один
+    void CheckRGB() const {
+        if (channels != 3)
+            throw std::logic_error("операция определена только для кадров RGB");
+    }
+
+    size_t GetDataSize() const { return (size_t)width * height * channels; }
+
+    static std::shared_ptr<unsigned char>
+    Allocate(size_t size, const std::shared_ptr<PixelBufferPool> &pool) {
+        if (pool)
+            return std::shared_ptr<unsigned char>(
+                pool->Acquire(),
+                [pool](unsigned char *buffer) { pool->Release(buffer); });
+        unsigned char *buffer = (unsigned char *)malloc(size);
+        if (!buffer && size)
+            throw std::bad_alloc();
+        return std::shared_ptr<unsigned char>(buffer, free);
+    }
+
+    // Отделяет буфер от других копий перед записью
+    void Detach() {
+        if (!data || data.use_count() == 1)
+            return;
+        std::shared_ptr<unsigned char> own = Allocate(GetDataSize(), pool);
+        memcpy(own.get(), data.get(), GetDataSize());
+        data = std::move(own);
+    }
+
+    // Кадр того же размера и пула с неинициализированными пикселями
+    Frame Blank() const {
+        Frame result;
+        result.width = width;
+        result.height = height;
+        result.channels = channels;
+        result.pool = pool;
+        result.data = Allocate(GetDataSize(), pool);
+        return result;
+    }
     class GLTexture : public IGLTexture {
         GLuint texture;
 
       public:
         GLTexture(const Frame &frame) {
+            GLenum format = frame.channels == 1 ? GL_RED : GL_RGB;
             glGenTextures(1, &texture);
             glBindTexture(GL_TEXTURE_2D, texture);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            if (frame.channels == 1)
+                SetGrayscaleSwizzle();
             glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, frame.width, frame.height, 0,
-                         GL_RGB, GL_UNSIGNED_BYTE, frame.data);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, frame.width, frame.height, 0,
+                         format, GL_UNSIGNED_BYTE, frame.GetData());
         }
         virtual ~GLTexture() { glDeleteTextures(1, &texture); }
         virtual GLuint GetTexture() const { return texture; }
     };
-    class FrameHistogram : IHistogram<IRGBColor, int> {
-        PATypes::HashMap<IRGBColor &, int> storage;
-
-      public:
-        FrameHistogram(const Frame &frame) {
-            for (size_t i = 0; i < frame.width; ++i) {
-                for (size_t j = 0; j < frame.height; ++j) {
-                    try {
-                        storage.Add(*frame.GetPoint({i, j}),
-                                    (storage.Get(*frame.GetPoint({i, j}))));
-                    } catch (std::out_of_range &) {
-                        storage.Add(*frame.GetPoint({i, j}), 1);
-                    }
-                }
-            }
-        }
-        virtual int GetFrequency(IRGBColor &color) const {
-            try {
-                return storage.Get(color);
-            } catch (std::out_of_range &) {
-                return 0;
-            }
-        }
-    };
 
   public:
+    // Одноканальная текстура привязанной GL_TEXTURE_2D читается шейдером
+    // как (Y, Y, Y, 1): кадр яркости показывается серым без перевода в RGB
+    static void SetGrayscaleSwizzle() {
+        GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, GL_ONE};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+
     Frame() : width(0), height(0), channels(0) {}
+    // O(1): пиксели общие до первой записи в одну из копий
     Frame(const Frame &frame)
-        : width(frame.width), height(frame.height), channels(frame.channels) {
-        this->data = (unsigned char *)malloc(frame.channels * frame.width *
-                                             frame.height);
-        for (int i = 0; i < frame.channels * frame.width * frame.height; ++i) {
-            this->data[i] = frame.data[i];
-        }
-    }
+        : data(frame.data), width(frame.width), height(frame.height),
+          channels(frame.channels), pool(frame.pool),
+          lumaHistogram(frame.lumaHistogram.load()),
+          downscaled(frame.downscaled.load()),
+          maskedHistogram(frame.maskedHistogram.load()) {}
     Frame(int width, int height, int channels, const unsigned char *data)
         : width(width), height(height), channels(channels) {
-        this->data = (unsigned char *)malloc(channels * width * height);
-        for (int i = 0; i < width * height * channels; ++i) {
-            this->data[i] = data[i];
-        }
+        this->data = Allocate(GetDataSize(), nullptr);
+        memcpy(this->data.get(), data, GetDataSize());
     }
-    Frame(Frame &&frame)
-        : width(frame.width), height(frame.height), channels(frame.channels) {
-        data = frame.data;
-        frame.data = nullptr;
+    Frame(int width, int height, int channels)
+        : width(width), height(height), channels(channels) {
+        this->data = Allocate(GetDataSize(), nullptr);
+    }
+    // Кадр с неинициализированными пикселями из буфера пула
+    Frame(int width, int height, int channels,
+          std::shared_ptr<PixelBufferPool> pool)
+        : width(width), height(height), channels(channels), pool(pool) {
+        if ((size_t)width * height * channels > pool->GetBufferSize())
+            throw std::logic_error("буфер пула меньше кадра");
+        this->data = Allocate(GetDataSize(), pool);
     }
+    Frame(Frame &&frame)
+        : data(std::move(frame.data)), width(frame.width),
+          height(frame.height), channels(frame.channels),
+          tag(std::move(frame.tag)), pool(std::move(frame.pool)),
+          lumaHistogram(frame.lumaHistogram.exchange({})),
+          downscaled(frame.downscaled.exchange({})),
+          maskedHistogram(frame.maskedHistogram.exchange({})) {}
     std::shared_ptr<IGLTexture> GetTexture() const {
         return std::make_shared<GLTexture>(*this);
     }
-    virtual ~Frame() {
-        if (data)
-            stbi_image_free(data);
-    }
+    virtual ~Frame() {}
     virtual std::shared_ptr<ITag> GetTag() { return tag; }
     virtual void SetTag(std::shared_ptr<ITag> tag) { this->tag = tag; }
     static std::shared_ptr<Frame> FromFile(const std::string &filename) {
         std::shared_ptr<Frame> newFrame = std::make_shared<Frame>(Frame());
-        newFrame->data = stbi_load(filename.c_str(), &newFrame->width,
-                                   &newFrame->height, &newFrame->channels, 3);
+        unsigned char *pixels =
+            stbi_load(filename.c_str(), &newFrame->width, &newFrame->height,
+                      &newFrame->channels, 3);
         newFrame->channels = 3;
-        if (!newFrame->data) {
+        if (!pixels) {
             throw std::runtime_error(stbi_failure_reason());
         }
+        newFrame->data =
+            std::shared_ptr<unsigned char>(pixels, stbi_image_free);
         return newFrame;
     }
-    const unsigned char *GetData() const { return data; }
+    // Одноканальный кадр из плоскости с шагом строки linesize (>= width),
+    // например из плоскости Y декодированного кадра
+    static Frame FromPlane(const unsigned char *plane, int linesize, int width,
+                           int height,
+                           std::shared_ptr<PixelBufferPool> pool = nullptr) {
+        Frame result = pool ? Frame(width, height, 1, pool)
+                            : Frame(width, height, 1);
+        unsigned char *target = result.GetMutableData();
+        if (linesize == width) {
+            memcpy(target, plane, (size_t)width * height);
+        } else {
+            for (int y = 0; y < height; ++y) {
+                memcpy(target + (size_t)y * width,
+                       plane + (size_t)y * linesize, width);
+            }
+        }
+        return result;
+    }
+    const unsigned char *GetData() const { return data.get(); }
+    // Указатель для записи; общий с копиями буфер перед этим копируется
+    unsigned char *GetMutableData() {
+        Detach();
+        lumaHistogram.store(nullptr);
+        downscaled.store(nullptr);
+        maskedHistogram.store(nullptr);
+        return data.get();
+    }
+    bool SharesData(const Frame &other) const {
+        return data && data == other.data;
+    }
+    int GetChannels() const { return channels; }
     std::shared_ptr<IRGBColor> GetPoint(const Dot &at) const {
+        CheckRGB();
         std::shared_ptr<RGBColor> res =
-            std::make_shared<RGBColor>(data[(at.x + at.y * width) * channels]);
+            std::make_shared<RGBColor>(data.get()[(at.x + at.y * width) * channels]);
         return res;
     }
     Frame delta(const Frame &b) const {
-        Frame newFrame(*this);
         if (width != b.width || height != b.height || channels != b.channels)
             throw std::logic_error("кадры несовместимы для операции delta");
-        for (int i = 0; i < width * height * channels; ++i) {
-            newFrame.data[i] = std::abs((int)data[i] - b.data[i]);
-        }
+        Frame newFrame = Blank();
+        PixelKernels::Kernels().absDiff(GetData(), b.GetData(),
+                                        newFrame.data.get(), GetDataSize());
         return newFrame;
     }
+    // То же, что delta(b).norm(), но за один проход без временного кадра
+    double MeanAbsDiff(const Frame &b) const {
+        if (width != b.width || height != b.height || channels != b.channels)
+            throw std::logic_error("кадры несовместимы для операции delta");
+        if (!width || !height)
+            return 0;
+        uint64_t sum = PixelKernels::SumAbsDiff(
+            GetData(), b.GetData(), GetDataSize());
+        return (double)sum / (width * height);
+    }
+    // То же только по пикселям маски: читаются лишь её отрезки
+    double MeanAbsDiff(const Frame &b, const RegionMask &mask) const {
+        if (width != b.width || height != b.height || channels != b.channels)
+            throw std::logic_error("кадры несовместимы для операции delta");
+        CheckMask(mask);
+        if (!mask.GetPixelCount())
+            return 0;
+        uint64_t sum = 0;
+        mask.ForEachSpan([&](int y, int from, int to) {
+            size_t offset = ((size_t)y * width + from) * channels;
+            sum += PixelKernels::SumAbsDiff(GetData() + offset,
+                                            b.GetData() + offset,
+                                            (size_t)(to - from) * channels);
+        });
+        return (double)sum / mask.GetPixelCount();
+    }
+    // Энергия разности с кадром b по плиткам tileSize x tileSize
+    // (по маске — только её пикселей)
+    TileGrid TileDelta(const Frame &b,
+                       int tileSize = TileGrid::DefaultTileSize,
+                       const RegionMask *mask = nullptr) const {
+        if (width != b.width || height != b.height || channels != b.channels)
+            throw std::logic_error("кадры несовместимы для операции delta");
+        return TileGrid(GetData(), b.GetData(), width, height, channels,
+                        tileSize, mask);
+    }
     int GetWidth() const { return width; }
     int GetHeight() const { return height; }
+    // Гистограммы кадра с фиксированными корзинами, см. ColorHistogram.hpp
+    LumaHistogram GetLumaHistogram() const {
+        LumaHistogram result;
+        HistogramKernels::ComputeLuma(GetData(), (size_t)width * height,
+                                      channels, result);
+        return result;
+    }
+    LumaHistogram GetLumaHistogram(const RegionMask &mask) const {
+        CheckMask(mask);
+        uint32_t sub[HistogramKernels::SubHistograms][256] = {};
+        mask.ForEachSpan([&](int y, int from, int to) {
+            HistogramKernels::CountLuma(
+                GetData() + ((size_t)y * width + from) * channels, to - from,
+                channels, sub);
+        });
+        LumaHistogram result;
+        HistogramKernels::FoldLuma(sub, mask.GetPixelCount(), result);
+        return result;
+    }
+    ChannelHistograms GetChannelHistograms() const {
+        ChannelHistograms result;
+        HistogramKernels::ComputeChannels(GetData(), (size_t)width * height,
+                                          channels, result);
+        return result;
+    }
+    // То же, что GetLumaHistogram, но считается один раз на кадр
+    std::shared_ptr<const LumaHistogram> GetCachedLumaHistogram() const {
+        std::shared_ptr<const LumaHistogram> cached = lumaHistogram.load();
+        if (!cached) {
+            cached = std::make_shared<const LumaHistogram>(GetLumaHistogram());
+            lumaHistogram.store(cached);
+        }
+        return cached;
+    }
+    // То же по маске; запоминается для последней маски, с которой
+    // спрашивали, nullptr — по всему кадру
+    std::shared_ptr<const LumaHistogram>
+    GetCachedLumaHistogram(const std::shared_ptr<const RegionMask> &mask) const;
+    // Следующий уровень пирамиды: вдвое меньше по каждой оси, пиксель —
+    // среднее квадрата 2x2 (PyramidKernels::HalveRow). Нечётные последние
+    // строка и столбец отбрасываются.
+    Frame Halve() const {
+        Frame result(width / 2, height / 2, channels);
+        if (!result.width || !result.height)
+            return result;
+        size_t stride = (size_t)width * channels;
+        size_t outStride = (size_t)result.width * channels;
+        PATypes::DynamicArray<unsigned char> scratch(2 * outStride);
+        for (int y = 0; y < result.height; ++y) {
+            const unsigned char *top = GetData() + 2 * y * stride;
+            PyramidKernels::HalveRow(top, top + stride, result.width, channels,
+                                     &scratch[0],
+                                     result.data.get() + y * outStride);
+        }
+        return result;
+    }
+    // Кадр, уменьшенный в factor раз (1, 2, 4 или 8) по каждой оси
+    // последовательными Halve
+    Frame Downscale(int factor) const {
+        if (factor != 1 && factor != 2 && factor != 4 && factor != 8)
+            throw std::invalid_argument("масштаб анализа — 1, 2, 4 или 8");
+        Frame result(*this);
+        for (; factor > 1; factor /= 2) {
+            result = result.Halve();
+        }
+        return result;
+    }
+    // То же, что Downscale, но строится один раз на кадр и масштаб: кадр
+    // оценивается в паре и с предыдущим, и со следующим
+    std::shared_ptr<const Frame> GetDownscaled(int factor) const;
+    // Интегральные изображения яркости для признаков Хаара
+    IntegralImage GetIntegralImage() const {
+        return IntegralImage(GetData(), width, height, channels);
+    }
+    QuantizedRGBHistogram GetQuantizedRGBHistogram() const {
+        QuantizedRGBHistogram result;
+        HistogramKernels::ComputeQuantizedRGB(
+            GetData(), (size_t)width * height, channels, result);
+        return result;
+    }
     Frame XOR(const Frame &b) const {
-        Frame newFrame(*this);
         if (width != b.width || height != b.height || channels != b.channels)
             throw std::logic_error("кадры несовместимы для операции XOR");
-        for (int i = 0; i < width * height * channels; ++i) {
-            newFrame.data[i] = data[i] ^ b.data[i];
-        }
+        Frame newFrame = Blank();
+        PixelKernels::Kernels().bitXor(GetData(), b.GetData(),
+                                       newFrame.data.get(), GetDataSize());
         return newFrame;
     }
     Frame AND(const Frame &b) const {
-        Frame newFrame(*this);
         if (width != b.width || height != b.height || channels != b.channels)
-            throw std::logic_error("кадры несовместимы для операции XOR");
-        for (int i = 0; i < width * height * channels; ++i) {
-            newFrame.data[i] = (data[i] & b.data[i]);
-        }
+            throw std::logic_error("кадры несовместимы для операции AND");
+        Frame newFrame = Blank();
+        PixelKernels::Kernels().bitAnd(GetData(), b.GetData(),
+                                       newFrame.data.get(), GetDataSize());
         return newFrame;
     }
+    // Результат делит буфер с исходным кадром, пока f не изменит пиксель
     Frame Map(IRGBColor &(*f)(const IRGBColor &a)) const {
+        CheckRGB();
         Frame newFrame(*this);
-        for (int i = 0; i < width * height; i += channels) {
-            IRGBColor &res = f(RGBColor(newFrame.data + i));
-            newFrame.data[i] = res.GetR();
-            newFrame.data[i + 1] = res.GetG();
-            newFrame.data[i + 2] = res.GetB();
+        // RGBColor только читает source; запись идёт через target
+        unsigned char *source = data.get();
+        unsigned char *target = nullptr;
+        for (size_t i = 0; i < GetDataSize(); i += channels) {
+            IRGBColor &res = f(RGBColor(source + i));
+            unsigned char r = res.GetR(), g = res.GetG(), b = res.GetB();
+            if (!target) {
+                if (r == source[i] && g == source[i + 1] && b == source[i + 2])
+                    continue;
+                target = newFrame.GetMutableData();
+            }
+            target[i] = r;
+            target[i + 1] = g;
+            target[i + 2] = b;
         }
         return newFrame;
     }
     template <class T>
     T Reduce(T (*f)(const T &, const IRGBColor &), IRGBColor &init) const {
+        CheckRGB();
         T result = f(T(0), init);
         for (int i = 0; i < width * height; i += channels) {
-            result = f(result, RGBColor(data + i));
+            result = f(result, RGBColor(data.get() + i));
         }
         return result;
     }
     double norm() const {
-        double res = 0;
-        for (int i = 0; i < width * height * channels; ++i) {
-            res += data[i];
-        }
+        double res = PixelKernels::Kernels().sum(GetData(), GetDataSize());
         res /= (width * height);
         return res;
     }
     Frame &operator=(const Frame &other) {
         if (this == &other)
             return *this;
-        if (data && width && height)
-            free(data);
-        this->data = (unsigned char *)malloc(other.channels * other.width *
-                                             other.height);
-        for (int i = 0; i < other.channels * other.width * other.height; ++i) {
-            this->data[i] = other.data[i];
-        }
+        this->data = other.data;
+        this->pool = other.pool;
+        this->lumaHistogram = other.lumaHistogram.load();
+        this->downscaled = other.downscaled.load();
+        this->maskedHistogram = other.maskedHistogram.load();
+        this->width = other.width;
+        this->height = other.height;
+        this->channels = other.channels;
+        return *this;
+    }
+    Frame &operator=(Frame &&other) {
+        if (this == &other)
+            return *this;
+        this->data = std::move(other.data);
+        this->pool = std::move(other.pool);
+        this->lumaHistogram = other.lumaHistogram.exchange({});
+        this->downscaled = other.downscaled.exchange({});
+        this->maskedHistogram = other.maskedHistogram.exchange({});
         this->width = other.width;
         this->height = other.height;
         this->channels = other.channels;
+        this->tag = std::move(other.tag);
         return *this;
     }
 };
 
-class FrameSequence : public PATypes::MutableListSequence<Frame>,
+struct Frame::Downscaled {
+    int factor;
+    Frame frame;
+};
+
+inline std::shared_ptr<const Frame> Frame::GetDownscaled(int factor) const {
+    std::shared_ptr<const Downscaled> cached = downscaled.load();
+    if (!cached || cached->factor != factor) {
+        cached = std::make_shared<const Downscaled>(
+            Downscaled{factor, Downscale(factor)});
+        downscaled.store(cached);
+    }
+    return std::shared_ptr<const Frame>(cached, &cached->frame);
+}
+
+struct Frame::MaskedHistogram {
+    std::shared_ptr<const RegionMask> mask;
+    LumaHistogram histogram;
+};
+
+inline std::shared_ptr<const LumaHistogram> Frame::GetCachedLumaHistogram(
+    const std::shared_ptr<const RegionMask> &mask) const {
+    if (!mask)
+        return GetCachedLumaHistogram();
+    std::shared_ptr<const MaskedHistogram> cached = maskedHistogram.load();
+    if (!cached || cached->mask != mask) {
+        cached = std::make_shared<const MaskedHistogram>(
+            MaskedHistogram{mask, GetLumaHistogram(*mask)});
+        maskedHistogram.store(cached);
+    }
+    return std::shared_ptr<const LumaHistogram>(cached, &cached->histogram);
+}
+
+// В каком виде VideoFrameReader отдаёт кадры
+enum class DecodeFormat {
+    // RGB24 через sws_scale, для просмотра
+    RGB,
+    // Один канал яркости. Из YUV-видео плоскость Y копируется как есть, без
+    // sws_scale: втрое меньше байт на кадр и для декодирования, и для
+    // оценок. Оценки разности пикселей в этом режиме примерно втрое
+    // меньше, чем по RGB (одна разность на пиксель вместо трёх). В окне
+    // просмотра такой кадр показывается серым swizzle текстуры.
+    Luma
+};
+
+// Чтение кадров видеофайла в RGB24 или в яркость
+class VideoFrameReader {
+    VideoDecoder decoder;
+    DecodeFormat format;
+    // во сколько раз кадры уменьшаются по каждой оси прямо в sws_scale
+    int scale;
+    int width, height;
+    // для RGB — всегда, для яркости — только если у формата декодера нет
+    // плоскости Y или кадр уменьшается (тогда sws_scale в GRAY8);
+    // создаётся при первом кадре
+    struct SwsContext *sws_ctx;
+    int swsSourceFormat;
+    std::shared_ptr<PixelBufferPool> pool;
+
+    int GetChannels() const { return format == DecodeFormat::Luma ? 1 : 3; }
+
+    SwsContext *GetScaler(int sourceFormat) {
+        if (sws_ctx && sourceFormat == swsSourceFormat)
+            return sws_ctx;
+        sws_freeContext(sws_ctx);
+        sws_ctx = sws_getContext(
+            decoder.GetWidth(), decoder.GetHeight(),
+            (enum AVPixelFormat)sourceFormat, width, height,
+            format == DecodeFormat::Luma ? AV_PIX_FMT_GRAY8 : AV_PIX_FMT_RGB24,
+            scale > 1 ? SWS_AREA : SWS_BILINEAR, NULL, NULL, NULL);
+        if (!sws_ctx)
+            throw std::logic_error("Ошибка при загрузке видео");
+        swsSourceFormat = sourceFormat;
+        return sws_ctx;
+    }
+
+  public:
+    // scale — 1, 2, 4 или 8: кадры только для анализа можно уменьшить уже
+    // при переводе из формата декодера, тогда полный кадр не пишется вовсе
+    VideoFrameReader(const std::string &filename, int decodeThreads = 0,
+                     DecodeFormat format = DecodeFormat::RGB, int scale = 1)
+        : decoder(filename, decodeThreads), format(format), scale(scale),
+          width(decoder.GetWidth() / scale),
+          height(decoder.GetHeight() / scale), sws_ctx(NULL),
+          swsSourceFormat(AV_PIX_FMT_NONE) {
+        if (scale != 1 && scale != 2 && scale != 4 && scale != 8)
+            throw std::invalid_argument("масштаб анализа — 1, 2, 4 или 8");
+        pool = std::make_shared<PixelBufferPool>((size_t)width * height *
+                                                 GetChannels());
+        if (format == DecodeFormat::RGB)
+            GetScaler(decoder.GetPixelFormat());
+    }
+    VideoFrameReader(const VideoFrameReader &) = delete;
+    VideoFrameReader &operator=(const VideoFrameReader &) = delete;
+    ~VideoFrameReader() { sws_freeContext(sws_ctx); }
+
+    DecodeFormat GetFormat() const { return format; }
+    int GetScale() const { return scale; }
+    float GetFramerate() const { return decoder.GetFramerate(); }
+    double GetDuration() const { return decoder.GetDuration(); }
+    double GetPosition() const { return decoder.GetPosition(); }
+    int GetDecodeThreads() const { return decoder.GetDecodeThreads(); }
+    const char *GetDecodeThreadType() const {
+        return decoder.GetDecodeThreadType();
+    }
+
+    std::optional<Frame> Read() {
+        const AVFrame *frame = decoder.Next();
+        if (!frame)
+            return std::nullopt;
+
+        if (format == DecodeFormat::Luma && scale == 1 &&
+            HasLumaPlane(frame->format))
+            return Frame::FromPlane(frame->data[0], frame->linesize[0],
+                                    decoder.GetWidth(), decoder.GetHeight(),
+                                    pool);
+
+        // sws_scale пишет сразу в буфер кадра: промежуточного RGB-кадра нет,
+        // а буферы кадров, отпущенных потребителем, берутся из пула повторно
+        Frame result(width, height, GetChannels(), pool);
+        uint8_t *dst[4] = {result.GetMutableData(), NULL, NULL, NULL};
+        int dstStride[4] = {width * GetChannels(), 0, 0, 0};
+        sws_scale(GetScaler(frame->format),
+                  (uint8_t const *const *)frame->data, frame->linesize, 0,
+                  decoder.GetHeight(), dst, dstStride);
+        return result;
+    }
+};
+
+class FrameSequence : public PATypes::MutableArraySequence<Frame>,
                       public IScoreable {
     int windowLength;
 
     float treshold;
     float leapTreshold;
 
-    double GetDeltaScore() {
-        int lastIndex = getLength() - 1;
-        if (lastIndex < 0 || windowLength < 2) {
+    bool IsBackgroundMode() const {
+        return scoreMode == ScoreMode::BackgroundAverage ||
+               scoreMode == ScoreMode::BackgroundMedian ||
+               scoreMode == ScoreMode::Mixture;
+    }
+    // Оценка кадра r по модели фона (BackgroundModel или MixtureModel,
+    // смотря по режиму): модель проходит кадры строго по
+    // порядку, поэтому досчитываются все кадры до r, а готовые оценки
+    // хранятся в backgroundScores. Первый вызов для кадра r стоит O(r)
+    // обновлений модели, повторные — O(1); из потока UI оценки берутся
+    // через TryGetScore. Кадры раньше конца первого окна, пока фон не
+    // устоялся, не оцениваются — как и по окну дельт пар.
+    double GetDeltaScore(int r) {
+        if (r < 0 || windowLength < 2)
             return 0;
+        if (r - windowLength + 1 < 0)
+            throw std::out_of_range(
+                "окно оценки выходит за начало последовательности кадров");
+        if (!backgroundScores.getSize())
+            ResetBackground();
+        for (int i = backgroundScores.getSize(); i <= r; ++i) {
+            std::shared_ptr<const Frame> downscaled;
+            if (analysisScale > 1)
+                downscaled = Getrvalue(i).GetDownscaled(analysisScale);
+            const Frame &frame = downscaled ? *downscaled : Getrvalue(i);
+            backgroundScores.resize(i + 1);
+            if (scoreMode == ScoreMode::Mixture)
+                backgroundScores[i] = mixture.Update(
+                    frame.GetData(), frame.GetWidth(), frame.GetHeight(),
+                    frame.GetChannels(), analysisMask.get(), GetPool());
+            else
+                backgroundScores[i] = background.Update(
+                    frame.GetData(), frame.GetWidth(), frame.GetHeight(),
+                    frame.GetChannels(), analysisMask.get());
         }
-        Frame result = get(lastIndex);
-        for (int i = 1; i < windowLength; ++i) {
-            result = result.AND(get(lastIndex - i));
-        }
-        return get(lastIndex).delta(result).norm();
+        return backgroundScores[r];
+    }
+    // Фон строится заново с первого кадра: для режима фона — с его видом
+    // и текущим окном
+    void ResetBackground() {
+        background = BackgroundModel(scoreMode == ScoreMode::BackgroundMedian
+                                         ? BackgroundKind::RunningMedian
+                                         : BackgroundKind::RunningAverage,
+                                     windowLength);
+        mixture = MixtureModel(mixtureParams);
+        backgroundScores = PATypes::DynamicArray<double>(0);
+    }
+    double PairDelta(const Frame &current, const Frame &previous) {
+        if (scoreMode == ScoreMode::LumaHistogram)
+            return HistogramDistance(
+                *current.GetCachedLumaHistogram(analysisMask),
+                *previous.GetCachedLumaHistogram(analysisMask),
+                histogramMetric);
+        if (analysisMask)
+            return current.MeanAbsDiff(previous, *analysisMask);
+        return current.MeanAbsDiff(previous);
+    }
+    double PairDelta(int i) {
+        if (scoreMode == ScoreMode::Tiles)
+            return ComputeTileGrid(i)->GetMaxTileScore();
+        if (analysisScale > 1)
+            return PairDelta(*Getrvalue(i).GetDownscaled(analysisScale),
+                             *Getrvalue(i - 1).GetDownscaled(analysisScale));
+        return PairDelta(Getrvalue(i), Getrvalue(i - 1));
+    }
+    // Сетка плиток пары (i - 1, i) в масштабе анализа, запоминается в
+    // tileGrids[i]; массив растится заранее (GrowTileGrids), поэтому пары
+    // пишут каждая в свою ячейку и при параллельном расчёте
+    std::shared_ptr<const TileGrid> ComputeTileGrid(int i) {
+        std::shared_ptr<const TileGrid> grid;
+        if (analysisScale > 1)
+            grid = std::make_shared<const TileGrid>(
+                Getrvalue(i).GetDownscaled(analysisScale)->TileDelta(
+                    *Getrvalue(i - 1).GetDownscaled(analysisScale), tileSize,
+                    analysisMask.get()));
+        else
+            grid = std::make_shared<const TileGrid>(Getrvalue(i).TileDelta(
+                Getrvalue(i - 1), tileSize, analysisMask.get()));
+        tileGrids[i] = grid;
+        return grid;
+    }
+    void GrowTileGrids(int length) {
+        int previous = tileGrids.getSize();
+        if (length > previous)
+            tileGrids.resize(length);
+    }
+    // Маска в масштабе анализа; nullptr, если маски нет или она
+    // включает весь кадр
+    void UpdateAnalysisMask() {
+        if (!mask || mask->IsFull())
+            analysisMask = nullptr;
+        else if (analysisScale > 1)
+            analysisMask = std::make_shared<const RegionMask>(
+                mask->Downscale(analysisScale));
+        else
+            analysisMask = mask;
+    }
+    // Дельты пар и сетки плиток больше не соответствуют кадрам
+    void ClearPairs() {
+        windowScore.Clear();
+        tileGrids = PATypes::DynamicArray<std::shared_ptr<const TileGrid>>(0);
+        ResetBackground();
     }
     double GetDeltaScore2(int r) {
-        if (r < 0 || windowLength < 2) {
-            return 0;
-        }
-        double result = 0;
-        Frame lastFrame = get(r);
-        for (int i = 1; i < windowLength; ++i) {
-            result += lastFrame.delta(get(r - i)).norm();
-            lastFrame = get(r - i);
+        if (IsBackgroundMode())
+            return GetDeltaScore(r);
+        GrowTileGrids(getLength());
+        return windowScore.GetScore(r, windowLength,
+                                    [this](int i) { return PairDelta(i); });
+    }
+    void TagByScore(int r, double score, ScoreTagger &tagger,
+                    double brightness) {
+        Frame &current = Getrvalue(r);
+        std::shared_ptr<ITag> tag = tagger.Feed(score, &current, brightness);
+        if (tag) {
+            current.SetTag(tag);
+            TagsByIndex.append(PATypes::Pair(r, tag.get()));
         }
-        return result;
     }
-    PATypes::HashMap<int, double> cache;
+    SlidingWindowScore windowScore;
+    // tileGrids[i] — сетка плиток пары (i - 1, i) или nullptr
+    PATypes::DynamicArray<std::shared_ptr<const TileGrid>> tileGrids{0};
+    int tileSize = TileGrid::DefaultTileSize;
+    // модель фона после backgroundScores.getSize() кадров и их оценки
+    BackgroundModel background;
+    MixtureModel mixture;
+    MixtureParams mixtureParams;
+    PATypes::DynamicArray<double> backgroundScores{0};
+    int precalcThreads = 0;
+    std::shared_ptr<ThreadPool> pool;
+    ThreadPool *GetPool() {
+        int threads = precalcThreads > 0 ? precalcThreads
+                                         : ThreadPool::GetDefaultThreadCount();
+        if (threads == 1)
+            return nullptr;
+        if (!pool || pool->GetThreadCount() != threads)
+            pool = std::make_shared<ThreadPool>(threads);
+        return pool.get();
+    }
+    ScoreCache cache;
     PATypes::MutableArraySequence<PATypes::Pair<int, ITag *>> TagsByIndex;
     float frameRate;
+    int decodeThreads = 0;
+    ScoreMode scoreMode = ScoreMode::PixelDelta;
+    HistogramMetric histogramMetric = HistogramMetric::ChiSquare;
+    float flashTreshold = 40.0f;
+    int analysisScale = 1;
+    std::shared_ptr<const RegionMask> mask, analysisMask;
 
   public:
     FrameSequence(float treshold = 400.0f, float leapTreshold = 100.0f)
-        : PATypes::MutableListSequence<Frame>(), treshold(treshold),
+        : PATypes::MutableArraySequence<Frame>(), treshold(treshold),
           leapTreshold(leapTreshold), cache(), TagsByIndex() {}
     FrameSequence(Frame *items, int count, int windowLength,
                   float treshold = 400.0f, float leapTreshold = 100.0f)
-        : PATypes::MutableListSequence<Frame>(items, count),
+        : PATypes::MutableArraySequence<Frame>(items, count),
           windowLength(windowLength), treshold(treshold),
           leapTreshold(leapTreshold), cache(), frameRate(12) {}
     FrameSequence(PATypes::Sequence<Frame> &sequence, int windowLength,
                   float treshold = 400.0f, float leapTreshold = 100.0f)
-        : PATypes::MutableListSequence<Frame>(sequence),
+        : PATypes::MutableArraySequence<Frame>(sequence),
           windowLength(windowLength), cache(), frameRate(12) {}
     FrameSequence(FrameSequence &sequence)
-        : PATypes::MutableListSequence<Frame>(
+        : PATypes::MutableArraySequence<Frame>(
               (PATypes::Sequence<Frame> &)sequence),
           windowLength(sequence.windowLength), treshold(sequence.treshold),
-          leapTreshold(sequence.leapTreshold), cache(sequence.cache),
-          frameRate(sequence.frameRate) {}
+          leapTreshold(sequence.leapTreshold),
+          windowScore(sequence.windowScore), tileGrids(sequence.tileGrids),
+          tileSize(sequence.tileSize), background(sequence.background),
+          mixture(sequence.mixture), mixtureParams(sequence.mixtureParams),
+          backgroundScores(sequence.backgroundScores),
+          precalcThreads(sequence.precalcThreads), cache(sequence.cache),
+          frameRate(sequence.frameRate),
+          decodeThreads(sequence.decodeThreads), scoreMode(sequence.scoreMode),
+          histogramMetric(sequence.histogramMetric),
+          flashTreshold(sequence.flashTreshold),
+          analysisScale(sequence.analysisScale), mask(sequence.mask),
+          analysisMask(sequence.analysisMask) {}
     FrameSequence(FrameSequence &&sequence)
-        : PATypes::MutableListSequence<Frame>(std::move(sequence)),
+        : PATypes::MutableArraySequence<Frame>(std::move(sequence)),
           windowLength(sequence.windowLength), treshold(sequence.treshold),
-          leapTreshold(sequence.treshold), frameRate(sequence.frameRate) {
+          leapTreshold(sequence.leapTreshold),
+          windowScore(std::move(sequence.windowScore)),
+          tileGrids(std::move(sequence.tileGrids)),
+          tileSize(sequence.tileSize),
+          background(std::move(sequence.background)),
+          mixture(std::move(sequence.mixture)),
+          mixtureParams(sequence.mixtureParams),
+          backgroundScores(std::move(sequence.backgroundScores)),
+          precalcThreads(sequence.precalcThreads),
+          frameRate(sequence.frameRate),
+          decodeThreads(sequence.decodeThreads), scoreMode(sequence.scoreMode),
+          histogramMetric(sequence.histogramMetric),
+          flashTreshold(sequence.flashTreshold),
+          analysisScale(sequence.analysisScale), mask(sequence.mask),
+          analysisMask(sequence.analysisMask) {
         cache = std::move(sequence.cache);
     }
     FrameSequence(int windowLength, float treshold = 400.0f,
                   float leapTreshold = 100.0f)
-        : PATypes::MutableListSequence<Frame>(), windowLength(windowLength),
+        : PATypes::MutableArraySequence<Frame>(), windowLength(windowLength),
           treshold(treshold), leapTreshold(leapTreshold), cache(),
           frameRate(12) {}
     FrameSequence(Frame item, int windowLength, float treshold = 400.0f,
                   float leapTreshold = 100.0f)
-        : PATypes::MutableListSequence<Frame>(), windowLength(windowLength),
+        : PATypes::MutableArraySequence<Frame>(), windowLength(windowLength),
           treshold(treshold), leapTreshold(leapTreshold), cache(),
           frameRate(12) {}
-    static FrameSequence LoadFromVideo(const std::string &filename,
-                                       int windowSize) {
+    // decodeThreads — потоки декодера FFmpeg, 0 — по числу ядер;
+    // DecodeFormat::Luma — кадры только для оценки, из плоскости Y
+    static FrameSequence
+    LoadFromVideo(const std::string &filename, int windowSize,
+                  int decodeThreads = 0,
+                  DecodeFormat format = DecodeFormat::RGB) {
         FrameSequence result(windowSize);
-
-        AVFormatContext *fmt_ctx = NULL;
-        AVCodecContext *dec_ctx = NULL;
-        AVPacket *pkt = av_packet_alloc();
-        AVFrame *frame = av_frame_alloc();
-        int streamIndex;
-
-        if (avformat_open_input(&fmt_ctx, filename.c_str(), NULL, NULL) < 0) {
-            throw std::logic_error("Ошибка при загрузке видео");
-        }
-
-        if (avformat_find_stream_info(fmt_ctx, NULL) < 0) {
-            throw std::logic_error("Ошибка при загрузке видео");
-        }
-
-        if (open_codec_context(filename, &streamIndex, &dec_ctx, fmt_ctx,
-                               AVMEDIA_TYPE_VIDEO) < 0) {
-            throw std::logic_error("Ошибка при загрузке видео");
-        }
-        AVFrame *frameRGB;
-        uint8_t *buffer;
-
-        int ret = 0;
-
-        int numBytes = av_image_get_buffer_size(
-            AV_PIX_FMT_RGB24, dec_ctx->width, dec_ctx->height, 1);
-
-        struct SwsContext *sws_ctx = sws_getContext(
-            dec_ctx->width, dec_ctx->height, dec_ctx->pix_fmt, dec_ctx->width,
-            dec_ctx->height, AV_PIX_FMT_RGB24, SWS_BILINEAR, NULL, NULL, NULL);
-
-        while (av_read_frame(fmt_ctx, pkt) >= 0) {
-            if (pkt->stream_index == streamIndex) {
-                ret = avcodec_send_packet(dec_ctx, pkt);
-                if (ret < 0) {
-                    fprintf(stderr,
-                            "Error submitting a packet for decoding (%s)\n",
-                            av_err2str(ret));
-                    return ret;
-                }
-
-                while (ret >= 0) {
-                    ret = avcodec_receive_frame(dec_ctx, frame);
-                    if (ret < 0) {
-                        if (ret == AVERROR_EOF || ret == AVERROR(EAGAIN)) {
-                            ret = 0;
-                            break;
-                        }
-
-                        fprintf(stderr, "Error during decoding (%s)\n",
-                                av_err2str(ret));
-                        return ret;
-                    }
-
-                    frameRGB = av_frame_alloc();
-                    buffer = (uint8_t *)av_malloc(numBytes * sizeof(uint8_t));
-
-                    av_image_fill_arrays(frameRGB->data, frameRGB->linesize,
-                                         buffer, AV_PIX_FMT_RGB24,
-                                         dec_ctx->width, dec_ctx->height, 1);
-
-                    sws_scale(sws_ctx, (uint8_t const *const *)frame->data,
-                              frame->linesize, 0, dec_ctx->height,
-                              frameRGB->data, frameRGB->linesize);
-
-                    result.append(Frame(dec_ctx->width, dec_ctx->height, 3,
-                                        (unsigned char *)frameRGB->data[0]));
-
-                    av_frame_unref(frame);
-                    av_frame_free(&frameRGB);
-                    if (ret < 0)
-                        break;
-                }
-            }
-            av_packet_unref(pkt);
-            if (ret < 0)
-                break;
+        VideoFrameReader reader(filename, decodeThreads, format);
+        result.decodeThreads = reader.GetDecodeThreads();
+        while (std::optional<Frame> frame = reader.Read()) {
+            result.append(std::move(*frame));
         }
-
-        sws_freeContext(sws_ctx);
-        av_free(buffer);
-        av_frame_free(&frameRGB);
-
-        result.frameRate = dec_ctx->framerate.num / dec_ctx->framerate.den;
-
+        if (reader.GetFramerate() > 0)
+            result.frameRate = reader.GetFramerate();
         return result;
     }
+    // Окно кадра смотрит только назад, поэтому новый кадр в конце не меняет
+    // уже посчитанных оценок и кэш не сбрасывается
     virtual Sequence *append(Frame item) {
-        cache = PATypes::HashMap<int, double>();
-        return PATypes::MutableListSequence<Frame>::append(item);
+        return PATypes::MutableArraySequence<Frame>::append(std::move(item));
+    }
+    virtual Sequence *insertAt(Frame item, int index) {
+        cache.Clear();
+        ClearPairs();
+        return PATypes::MutableArraySequence<Frame>::insertAt(std::move(item),
+                                                              index);
     }
     static FrameSequence Where(bool (*f)(const Frame &), FrameSequence &input,
                                int windowLength = -1) {
@@ -392,6 +837,7 @@ class FrameSequence : public PATypes::MutableListSequence<Frame>,
                 result.append(enumerator->current());
             }
         }
+        delete enumerator;
         return result;
     }
     static FrameSequence Where(bool (*f)(const Frame &),
@@ -403,6 +849,7 @@ class FrameSequence : public PATypes::MutableListSequence<Frame>,
                 seq.append(enumerator->current());
             }
         }
+        delete enumerator;
         return seq;
     }
     virtual FrameSequence &Map(Frame (*f)(const Frame &)) {
@@ -410,68 +857,189 @@ class FrameSequence : public PATypes::MutableListSequence<Frame>,
         while (enumerator->moveNext()) {
             enumerator->current() = f(enumerator->current());
         }
+        delete enumerator;
+        cache.Clear();
+        ClearPairs();
         return *this;
     }
     void SetWindow(int windowLength) {
         if (windowLength != this->windowLength) {
             this->windowLength = windowLength;
-            cache = PATypes::HashMap<int, double>();
+            cache.Clear();
+            ResetBackground();
         }
     }
     int GetTagCount() { return TagsByIndex.getLength(); }
     auto GetTagEnumerator() { return TagsByIndex.getEnumerator(); }
     int GetWindow() const { return windowLength; }
     virtual void PrecalcScore() {
-        cache = PATypes::HashMap<int, double>();
+        ClearScores();
+        ScoreTagger tagger(treshold, leapTreshold, flashTreshold);
+        PrecalcScores(
+            [this, &tagger](int r, double score) {
+                AddScore(r, score, tagger, GetBrightness(r));
+            },
+            [](int) { return true; }, [] { return false; });
+    }
+    // Оценки всех кадров по порядку в onScore(r, score), без записи в кэш
+    // и без меток. keepGoing(done) вызывается после каждого блока кадров,
+    // false прерывает расчёт; cancelled() проверяется перед каждым кадром
+    // и прерывает его без ожидания конца блока. Так PrecalcScore
+    // выполняется по частям на копии последовательности в фоновой задаче.
+    template <class G, class H, class C>
+    bool PrecalcScores(G &&onScore, H &&keepGoing, C &&cancelled) {
+        if (IsBackgroundMode()) {
+            // кадры по порядку через один буфер фона, без пула
+            int frames = getLength();
+            for (int from = 0; from < frames;
+                 from += SlidingWindowScore::BlockLength) {
+                int to = std::min(frames,
+                                  from + SlidingWindowScore::BlockLength);
+                for (int r = std::max(from, windowLength - 1); r < to; ++r) {
+                    if (cancelled())
+                        return false;
+                    onScore(r, GetDeltaScore(r));
+                }
+                if (!keepGoing(to))
+                    return false;
+            }
+            return true;
+        }
+        GrowTileGrids(getLength());
+        return windowScore.Precalc(
+            getLength(), windowLength, [this](int i) { return PairDelta(i); },
+            onScore, GetPool(), keepGoing, cancelled);
+    }
+    // Сбрасывает оценки и метки перед новым расчётом
+    void ClearScores() {
+        cache.Clear();
         TagsByIndex =
             PATypes::MutableArraySequence<PATypes::Pair<int, ITag *>>();
-        double prevScore = 0.0f;
+    }
+    // Запоминает готовую оценку кадра r и ставит метку. Оценки подаются
+    // по возрастанию r одним и тем же tagger; brightness — GetBrightness(r)
+    void AddScore(int r, double score, ScoreTagger &tagger,
+                  double brightness = NAN) {
+        cache.Set(r, score);
+        TagByScore(r, score, tagger, brightness);
+    }
+    // Средняя яркость кадра r для меток вспышек; в режиме разности
+    // пикселей гистограммы не считаются и яркость не нужна — NaN
+    double GetBrightness(int r) {
+        if (scoreMode != ScoreMode::LumaHistogram)
+            return NAN;
+        if (analysisScale > 1)
+            return Getrvalue(r)
+                .GetDownscaled(analysisScale)
+                ->GetCachedLumaHistogram(analysisMask)
+                ->GetMean();
+        return Getrvalue(r).GetCachedLumaHistogram(analysisMask)->GetMean();
+    }
+    bool HasScore(int r) { return cache.Has(r); }
+    // Оценка кадра r без долгого расчёта, для потока UI: по окну дельт пар
+    // она досчитывается за O(windowLength), а в режимах фона — только
+    // готовая (из кэша или уже пройденная моделью), иначе nullopt. Модель
+    // прогоняет по порядку PrecalcScore или PrecalcJob. Для кадров, чьё
+    // окно выходит за начало последовательности, тоже nullopt.
+    std::optional<double> TryGetScore(int r) {
+        if (r < 0 || r >= getLength())
+            return std::nullopt;
+        // окно кадра выходит за начало последовательности — оценки нет
+        if (windowLength >= 2 && r < windowLength - 1)
+            return std::nullopt;
+        if (std::optional<double> cached = cache.TryGet(r))
+            return cached;
+        if (IsBackgroundMode() && r >= backgroundScores.getSize())
+            return std::nullopt;
+        return GetScore(r);
+    }
+    // Ставит ObjectTag кадрам, где каскад нашёл объект; кадры, уже
+    // помеченные по оценке, не трогаются. Окна кадра проверяются на пуле
+    // PrecalcScore. Возвращает число новых меток.
+    int TagObjects(const HaarCascade &cascade,
+                   const HaarDetectParams &params = HaarDetectParams()) {
+        int tagged = 0;
         for (int r = 0; r < getLength(); ++r) {
-            double score = 0.0f;
-            if (r >= this->getLength()) {
-            } else {
-                try {
-                    score = cache.Get(r);
-                } catch (std::out_of_range &e) {
-                    try {
-                        cache.Add(r, GetDeltaScore2(r) * 1.0);
-                        score = cache.Get(r);
-                    } catch (std::out_of_range &e) {
-                        continue;
-                    }
-                }
-            }
-            if (std::fabs(score - prevScore) > leapTreshold) {
-                Frame &current = list.get(r);
-                current.SetTag((std::shared_ptr<ITag>)
-                                   std::make_shared<ScoreLeapTag>(&current));
-                TagsByIndex.append(PATypes::Pair(r, current.GetTag().get()));
-            } else if (score > treshold) {
-                Frame &current = list.get(r);
-                current.SetTag((std::shared_ptr<ITag>)
-                                   std::make_shared<HighScoreTag>(&current));
-                TagsByIndex.append(PATypes::Pair(r, current.GetTag().get()));
-            }
-            prevScore = score;
+            Frame &current = Getrvalue(r);
+            if (current.GetTag())
+                continue;
+            if (!cascade.Detect(current.GetIntegralImage(), params, GetPool())
+                     .getLength())
+                continue;
+            std::shared_ptr<ITag> tag = std::make_shared<ObjectTag>(&current);
+            current.SetTag(tag);
+            TagsByIndex.append(PATypes::Pair(r, tag.get()));
+            ++tagged;
+        }
+        return tagged;
+    }
+    // Дельты пар, посчитанные на копии последовательности
+    void MergePairs(FrameSequence &other) {
+        windowScore.Merge(other.windowScore);
+        // модель фона переносится целиком вместе с пройденными кадрами
+        if (other.scoreMode == scoreMode && other.windowLength == windowLength &&
+            other.analysisScale == analysisScale && other.mask == mask &&
+            other.mixtureParams == mixtureParams &&
+            other.backgroundScores.getSize() > backgroundScores.getSize()) {
+            background = other.background;
+            mixture = other.mixture;
+            backgroundScores = other.backgroundScores;
+        }
+        if (other.tileSize != tileSize || other.analysisScale != analysisScale ||
+            other.mask != mask)
+            return;
+        GrowTileGrids(other.tileGrids.getSize());
+        for (int i = 0; i < other.tileGrids.getSize(); ++i) {
+            if (!tileGrids[i])
+                tileGrids[i] = other.tileGrids[i];
         }
     }
+    // Сетка плиток кадра r относительно предыдущего (см. TileGrid) в
+    // масштабе анализа: посчитанная при оценке в режиме ScoreMode::Tiles
+    // или досчитанная сейчас. Для первого кадра — nullptr.
+    std::shared_ptr<const TileGrid> GetTileGrid(int r) {
+        if (r <= 0 || r >= getLength())
+            return nullptr;
+        GrowTileGrids(getLength());
+        if (tileGrids[r])
+            return tileGrids[r];
+        return ComputeTileGrid(r);
+    }
+    // Изменение области [x, x + w) x [y, y + h) кадра r относительно
+    // предыдущего, в пикселях полного кадра: средний модуль разности по
+    // задетым плиткам
+    double GetRegionScore(int r, int x, int y, int w, int h) {
+        std::shared_ptr<const TileGrid> grid = GetTileGrid(r);
+        if (!grid)
+            return 0;
+        return grid->GetRegionScore(x / analysisScale, y / analysisScale,
+                                    w / analysisScale, h / analysisScale);
+    }
     virtual double GetScore(const std::optional<int> &r = std::nullopt) {
         if (r) {
             if (r >= this->getLength()) {
                 return 0;
             } else {
-                try {
-                    return cache.Get(*r);
-                } catch (std::out_of_range &e) {
-                    cache.Add(*r, GetDeltaScore2(*r) * 1.0);
-                    return cache.Get(*r);
-                }
+                if (std::optional<double> cached = cache.TryGet(*r))
+                    return *cached;
+                double score = GetDeltaScore2(*r) * 1.0;
+                cache.Set(*r, score);
+                return score;
             }
         } else {
             return GetDeltaScore2(this->getLength() - 1) * 1.0;
         }
     }
 
+    // Число потоков PrecalcScore: 0 — по числу ядер, 1 — последовательно.
+    // Результат от числа потоков не зависит.
+    int GetPrecalcThreads() const { return precalcThreads; }
+    void SetPrecalcThreads(int threads) { precalcThreads = std::max(0, threads); }
+
+    // сколько потоков декодировало видео в LoadFromVideo, 0 — не из видео
+    int GetDecodeThreads() const { return decodeThreads; }
+    void SetDecodeThreads(int threads) { decodeThreads = threads; }
+
     float GetFramerate() const { return frameRate; }
     void SetFramerate(const float &frameRate) { this->frameRate = frameRate; }
 
@@ -481,23 +1049,127 @@ class FrameSequence : public PATypes::MutableListSequence<Frame>,
     float GetLeapTreshold() {return leapTreshold;}
     void SetLeapTreshold(float treshold) { this->leapTreshold = treshold; }
 
+    // скачок средней яркости, после которого кадр помечается вспышкой
+    float GetFlashTreshold() const { return flashTreshold; }
+    void SetFlashTreshold(float treshold) { flashTreshold = treshold; }
+
+    ScoreMode GetScoreMode() const { return scoreMode; }
+    HistogramMetric GetHistogramMetric() const { return histogramMetric; }
+    // Смена режима или метрики меняет все дельты пар — кэши сбрасываются
+    void SetScoreMode(ScoreMode mode,
+                      HistogramMetric metric = HistogramMetric::ChiSquare) {
+        if (mode == scoreMode && metric == histogramMetric)
+            return;
+        scoreMode = mode;
+        histogramMetric = metric;
+        cache.Clear();
+        windowScore.Clear();
+        ResetBackground();
+    }
+
+    // Во сколько раз по каждой оси уменьшаются кадры перед оценкой: 1, 2,
+    // 4 или 8. Уменьшенные копии строятся пирамидой (Frame::GetDownscaled)
+    // и хранятся при кадрах, сами кадры для показа остаются полными.
+    // Разность пикселей — среднее на пиксель, поэтому пороги от масштаба
+    // почти не зависят: усреднение 2x2 лишь гасит шум и мелкие изменения.
+    int GetAnalysisScale() const { return analysisScale; }
+    void SetAnalysisScale(int factor) {
+        if (factor != 1 && factor != 2 && factor != 4 && factor != 8)
+            throw std::invalid_argument("масштаб анализа — 1, 2, 4 или 8");
+        if (factor == analysisScale)
+            return;
+        analysisScale = factor;
+        UpdateAnalysisMask();
+        cache.Clear();
+        ClearPairs();
+    }
+
+    // Маска области интереса в пикселях полного кадра: оценки, метки и
+    // сетки плиток считаются только по её пикселям, исключённые не
+    // читаются. nullptr — весь кадр. Маска не меняется после передачи
+    // сюда: новая маска — новый объект.
+    std::shared_ptr<const RegionMask> GetMask() const { return mask; }
+    void SetMask(std::shared_ptr<const RegionMask> mask) {
+        if (mask == this->mask)
+            return;
+        this->mask = std::move(mask);
+        UpdateAnalysisMask();
+        cache.Clear();
+        ClearPairs();
+    }
+
+    // Параметры смеси гауссиан для ScoreMode::Mixture; смена начинает
+    // модель заново
+    const MixtureParams &GetMixtureParams() const { return mixtureParams; }
+    void SetMixtureParams(const MixtureParams &params) {
+        mixtureParams = params;
+        cache.Clear();
+        ResetBackground();
+    }
+    // Смесь после последнего оценённого в режиме ScoreMode::Mixture кадра
+    // (GetBackgroundFrameCount() - 1): её маска переднего плана
+    const MixtureModel &GetMixture() const { return mixture; }
+    int GetBackgroundFrameCount() { return backgroundScores.getSize(); }
+
+    // Сторона плитки TileGrid в пикселях масштаба анализа
+    int GetTileSize() const { return tileSize; }
+    void SetTileSize(int size) {
+        if (size < 1)
+            throw std::invalid_argument("недопустимый размер плитки");
+        if (size == tileSize)
+            return;
+        tileSize = size;
+        cache.Clear();
+        ClearPairs();
+    }
+
     FrameSequence &operator=(const FrameSequence &other) {
         if (this == &other)
             return *this;
-        MutableListSequence<Frame>::operator=(other);
+        MutableArraySequence<Frame>::operator=(other);
         windowLength = other.windowLength;
+        windowScore = other.windowScore;
+        tileGrids = other.tileGrids;
+        tileSize = other.tileSize;
+        background = other.background;
+        mixture = other.mixture;
+        mixtureParams = other.mixtureParams;
+        backgroundScores = other.backgroundScores;
+        precalcThreads = other.precalcThreads;
         cache = other.cache;
         frameRate = other.frameRate;
+        decodeThreads = other.decodeThreads;
+        scoreMode = other.scoreMode;
+        histogramMetric = other.histogramMetric;
+        flashTreshold = other.flashTreshold;
+        analysisScale = other.analysisScale;
+        mask = other.mask;
+        analysisMask = other.analysisMask;
         return *this;
     }
     FrameSequence &operator=(FrameSequence &&other) {
         if (this == &other)
             return *this;
-        MutableListSequence<Frame>::operator=(other);
+        MutableArraySequence<Frame>::operator=(std::move(other));
         windowLength = other.windowLength;
+        windowScore = std::move(other.windowScore);
+        tileGrids = std::move(other.tileGrids);
+        tileSize = other.tileSize;
+        background = std::move(other.background);
+        mixture = std::move(other.mixture);
+        mixtureParams = other.mixtureParams;
+        backgroundScores = std::move(other.backgroundScores);
+        precalcThreads = other.precalcThreads;
         cache = std::move(other.cache);
         TagsByIndex = std::move(other.TagsByIndex);
         frameRate = other.frameRate;
+        decodeThreads = other.decodeThreads;
+        scoreMode = other.scoreMode;
+        histogramMetric = other.histogramMetric;
+        flashTreshold = other.flashTreshold;
+        analysisScale = other.analysisScale;
+        mask = other.mask;
+        analysisMask = other.analysisMask;
         return *this;
     }
 };
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <PATypes/DynamicArray.h>
+
+#include "Frame.hpp"
+
+namespace CCTV {
+// Ограниченная очередь между одним производителем и одним потребителем.
+// Push блокируется, пока очередь полна, — так производитель не уходит
+// вперёд больше чем на capacity элементов и память ограничена.
+// Блокировки берутся раз на кадр, на фоне декодирования это незаметно.
+template <class T> class BoundedQueue {
+    PATypes::DynamicArray<T> slots;
+    int head;
+    int count;
+    bool closed;
+    bool cancelled;
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+
+  public:
+    BoundedQueue(int capacity)
+        : slots(std::max(1, capacity)), head(0), count(0), closed(false),
+          cancelled(false) {}
+
+    int GetCapacity() { return slots.getSize(); }
+
+    // false — потребитель отменил чтение, элемент не принят
+    bool Push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock,
+                     [this] { return cancelled || count < slots.getSize(); });
+        if (cancelled)
+            return false;
+        slots[(head + count) % slots.getSize()] = std::move(item);
+        ++count;
+        notEmpty.notify_one();
+        return true;
+    }
+
+    // nullopt — очередь закрыта производителем и пуста, либо отменена
+    std::optional<T> Pop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return cancelled || closed || count; });
+        if (cancelled || !count)
+            return std::nullopt;
+        T item = std::move(slots[head]);
+        head = (head + 1) % slots.getSize();
+        --count;
+        notFull.notify_one();
+        return item;
+    }
+
+    // Не ждёт: nullopt — элементов пока нет (или больше не будет, см. IsDrained)
+    std::optional<T> TryPop() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (cancelled || !count)
+            return std::nullopt;
+        T item = std::move(slots[head]);
+        head = (head + 1) % slots.getSize();
+        --count;
+        notFull.notify_one();
+        return item;
+    }
+
+    // очередь закрыта производителем и пуста, либо отменена
+    bool IsDrained() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return cancelled || (closed && !count);
+    }
+
+    // производитель: элементов больше не будет
+    void Close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+    // потребитель: элементы больше не нужны, Push перестаёт блокироваться
+    void Cancel() {
+        std::lock_guard<std::mutex> lock(mutex);
+        cancelled = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+};
+
+// Конвейер чтения видео: демультиплексирование, декодирование и перевод
+// в RGB (или выделение яркости) идут в отдельном потоке, готовые кадры передаются через
+// ограниченную очередь. Пока потребитель оценивает кадр, следующий уже
+// декодируется, и время обработки стремится к max(декодирование, анализ).
+class DecodePipeline {
+    std::unique_ptr<VideoFrameReader> reader;
+    BoundedQueue<Frame> queue;
+    std::exception_ptr error;
+    std::thread producer;
+    float frameRate;
+    int decodeThreads;
+    double duration;
+    std::atomic<double> position;
+
+  public:
+    // queueLength — сколько декодированных кадров может ждать анализа;
+    // scale — уменьшение кадров в sws_scale, см. VideoFrameReader
+    DecodePipeline(const std::string &filename, int decodeThreads = 0,
+                   int queueLength = 8,
+                   DecodeFormat format = DecodeFormat::RGB, int scale = 1)
+        : reader(std::make_unique<VideoFrameReader>(filename, decodeThreads,
+                                                    format, scale)),
+          queue(queueLength), frameRate(reader->GetFramerate()),
+          decodeThreads(reader->GetDecodeThreads()),
+          duration(reader->GetDuration()), position(0) {
+        producer = std::thread([this] {
+            try {
+                while (std::optional<Frame> frame = reader->Read()) {
+                    position = reader->GetPosition();
+                    if (!queue.Push(std::move(*frame)))
+                        break;
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+            queue.Close();
+        });
+    }
+    DecodePipeline(const DecodePipeline &) = delete;
+    DecodePipeline &operator=(const DecodePipeline &) = delete;
+    ~DecodePipeline() {
+        queue.Cancel();
+        producer.join();
+    }
+
+    float GetFramerate() const { return frameRate; }
+    int GetDecodeThreads() const { return decodeThreads; }
+    // длительность видео в секундах, 0 — неизвестна
+    double GetDuration() const { return duration; }
+    // до какого момента видео в секундах дошло декодирование
+    double GetPosition() const { return position; }
+
+    // nullopt — видео закончилось; ошибка декодирования пробрасывается здесь
+    std::optional<Frame> Read() {
+        std::optional<Frame> frame = queue.Pop();
+        if (!frame && error)
+            std::rethrow_exception(error);
+        return frame;
+    }
+
+    // Не ждёт декодирования: nullopt — готового кадра пока нет или видео
+    // закончилось (IsFinished)
+    std::optional<Frame> TryRead() {
+        std::optional<Frame> frame = queue.TryPop();
+        if (!frame && queue.IsDrained() && error)
+            std::rethrow_exception(error);
+        return frame;
+    }
+    bool IsFinished() { return queue.IsDrained(); }
+
+    void Cancel() { queue.Cancel(); }
+};
+} // namespace CCTV
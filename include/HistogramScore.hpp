@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+#include "ColorHistogram.hpp"
+
+namespace CCTV {
+// Чем оценивается пара соседних кадров
+enum class ScoreMode {
+    // средний модуль разности пикселей (MeanAbsDiff)
+    PixelDelta,
+    // расстояние между гистограммами яркости: не замечает шума и мелкого
+    // движения, зато ловит смену сцены и вспышки
+    LumaHistogram,
+    // средний модуль разности в самой изменившейся плитке TileGrid:
+    // небольшой объект на большой статичной сцене не усредняется по кадру
+    Tiles,
+    // средний модуль разности кадра и фона сцены (BackgroundModel):
+    // скользящего среднего или приближения скользящей медианы
+    BackgroundAverage,
+    BackgroundMedian,
+    // доля пикселей переднего плана по смеси гауссиан (MixtureModel):
+    // качающаяся листва и блики становятся фоном, а не движением
+    Mixture
+};
+
+enum class HistogramMetric { ChiSquare, Bhattacharyya, EarthMovers };
+
+inline const char *GetScoreModeName(ScoreMode mode) {
+    switch (mode) {
+    case ScoreMode::PixelDelta:
+        return "Разность пикселей";
+    case ScoreMode::LumaHistogram:
+        return "Гистограмма яркости";
+    case ScoreMode::Tiles:
+        return "Плитки";
+    case ScoreMode::BackgroundAverage:
+        return "Фон: среднее";
+    case ScoreMode::BackgroundMedian:
+        return "Фон: медиана";
+    case ScoreMode::Mixture:
+        return "Смесь гауссиан";
+    }
+    return "?";
+}
+
+inline const char *GetHistogramMetricName(HistogramMetric metric) {
+    switch (metric) {
+    case HistogramMetric::ChiSquare:
+        return "Хи-квадрат";
+    case HistogramMetric::Bhattacharyya:
+        return "Бхаттачарья";
+    case HistogramMetric::EarthMovers:
+        return "EMD";
+    }
+    return "?";
+}
+
+// Расстояние между гистограммами по долям пикселей в корзинах. Все метрики
+// приведены к шкале 0..255, как у разности яркостей, чтобы пороги оценок
+// подходили для обоих режимов:
+// хи-квадрат sum (p - q)^2 / (p + q) лежит в [0, 2] и умножается на 127.5;
+// расстояние Бхаттачарьи sqrt(1 - sum sqrt(p q)) лежит в [0, 1] и
+// умножается на 255; EMD одномерной гистограммы — sum |P - Q| по
+// накопленным долям, это и есть среднее смещение в корзинах.
+template <int N>
+double HistogramDistance(const BinnedHistogram<N> &a,
+                         const BinnedHistogram<N> &b, HistogramMetric metric) {
+    if (!a.total || !b.total)
+        return 0;
+    double scaleA = 1.0 / a.total, scaleB = 1.0 / b.total;
+    double result = 0;
+    switch (metric) {
+    case HistogramMetric::ChiSquare:
+        for (int i = 0; i < N; ++i) {
+            double p = a.bins[i] * scaleA, q = b.bins[i] * scaleB;
+            if (p + q > 0)
+                result += (p - q) * (p - q) / (p + q);
+        }
+        return result * 127.5;
+    case HistogramMetric::Bhattacharyya:
+        for (int i = 0; i < N; ++i) {
+            result += std::sqrt(a.bins[i] * scaleA * b.bins[i] * scaleB);
+        }
+        return std::sqrt(std::max(0.0, 1 - result)) * 255;
+    case HistogramMetric::EarthMovers: {
+        double cumulativeA = 0, cumulativeB = 0;
+        for (int i = 0; i < N; ++i) {
+            cumulativeA += a.bins[i] * scaleA;
+            cumulativeB += b.bins[i] * scaleB;
+            result += std::fabs(cumulativeA - cumulativeB);
+        }
+        return result * 256.0 / N;
+    }
+    }
+    throw std::invalid_argument("неизвестная метрика гистограмм");
+}
+} // namespace CCTV
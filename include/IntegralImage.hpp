@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include <PATypes/DynamicArray.h>
+
+#include "ColorHistogram.hpp"
+#include "PixelKernels.hpp"
+
+namespace CCTV {
+namespace IntegralKernels {
+// Одна строка интегральных изображений яркости и её квадратов:
+// sum[x + 1] = above[x + 1] + luma[0] + ... + luma[x], так же для квадратов.
+// sum[0] и sumSq[0] — нулевой столбец, не пишутся.
+inline void AccumulateRowScalar(const unsigned char *luma, size_t width,
+                                const uint32_t *above, uint32_t *sum,
+                                const uint64_t *aboveSq, uint64_t *sumSq) {
+    uint32_t row = 0;
+    uint64_t rowSq = 0;
+    for (size_t x = 0; x < width; ++x) {
+        row += luma[x];
+        rowSq += luma[x] * luma[x];
+        sum[x + 1] = above[x + 1] + row;
+        sumSq[x + 1] = aboveSq[x + 1] + rowSq;
+    }
+}
+
+#ifdef CCTV_X86_KERNELS
+// Префиксная сумма четырёх 32-битных полос сдвигами регистра:
+// (a, b, c, d) -> (a, a + b, a + b + c, a + b + c + d)
+__attribute__((target("sse2"))) inline __m128i PrefixSum4SSE2(__m128i v) {
+    v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+    return _mm_add_epi32(v, _mm_slli_si128(v, 8));
+}
+
+// По восемь пикселей за шаг. Квадрат яркости не больше 255^2 и точно
+// умещается в 16 бит без знака, поэтому mullo_epi16 даёт его целиком;
+// префикс квадратов внутри четвёрки (до 4 * 255^2) ещё 32-битный и только
+// потом расширяется до 64 бит вместе с переносом от предыдущих пикселей.
+__attribute__((target("sse2"))) inline void
+AccumulateRowSSE2(const unsigned char *luma, size_t width,
+                  const uint32_t *above, uint32_t *sum,
+                  const uint64_t *aboveSq, uint64_t *sumSq) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i carry = zero, carrySq = zero;
+    auto quad = [&](__m128i values, __m128i squares, size_t x) {
+        __m128i prefix = _mm_add_epi32(PrefixSum4SSE2(values), carry);
+        carry = _mm_shuffle_epi32(prefix, 0xFF);
+        _mm_storeu_si128(
+            (__m128i *)(sum + x + 1),
+            _mm_add_epi32(prefix,
+                          _mm_loadu_si128((const __m128i *)(above + x + 1))));
+        __m128i prefixSq = PrefixSum4SSE2(squares);
+        __m128i low = _mm_add_epi64(_mm_unpacklo_epi32(prefixSq, zero), carrySq);
+        __m128i high = _mm_add_epi64(_mm_unpackhi_epi32(prefixSq, zero), carrySq);
+        carrySq = _mm_unpackhi_epi64(high, high);
+        _mm_storeu_si128(
+            (__m128i *)(sumSq + x + 1),
+            _mm_add_epi64(low,
+                          _mm_loadu_si128((const __m128i *)(aboveSq + x + 1))));
+        _mm_storeu_si128(
+            (__m128i *)(sumSq + x + 3),
+            _mm_add_epi64(high,
+                          _mm_loadu_si128((const __m128i *)(aboveSq + x + 3))));
+    };
+    size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i bytes = _mm_loadl_epi64((const __m128i *)(luma + x));
+        __m128i values = _mm_unpacklo_epi8(bytes, zero);
+        __m128i squares = _mm_mullo_epi16(values, values);
+        quad(_mm_unpacklo_epi16(values, zero),
+             _mm_unpacklo_epi16(squares, zero), x);
+        quad(_mm_unpackhi_epi16(values, zero),
+             _mm_unpackhi_epi16(squares, zero), x + 4);
+    }
+    uint32_t row = _mm_cvtsi128_si32(carry);
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, carrySq);
+    uint64_t rowSq = lanes[0];
+    for (; x < width; ++x) {
+        row += luma[x];
+        rowSq += luma[x] * luma[x];
+        sum[x + 1] = above[x + 1] + row;
+        sumSq[x + 1] = aboveSq[x + 1] + rowSq;
+    }
+}
+#endif
+
+inline void AccumulateRow(const unsigned char *luma, size_t width,
+                          const uint32_t *above, uint32_t *sum,
+                          const uint64_t *aboveSq, uint64_t *sumSq) {
+#ifdef CCTV_X86_KERNELS
+    if (PixelKernels::GetSimdLevel() != PixelKernels::SimdLevel::Scalar) {
+        AccumulateRowSSE2(luma, width, above, sum, aboveSq, sumSq);
+        return;
+    }
+#endif
+    AccumulateRowScalar(luma, width, above, sum, aboveSq, sumSq);
+}
+} // namespace IntegralKernels
+
+// Интегральные изображения (summed-area table) яркости кадра и её
+// квадратов: Sum(x, y) — сумма по пикселям левее x и выше y, поэтому сумма
+// по любому прямоугольнику и дисперсия в нём берутся по четырём углам за
+// O(1). Таблицы на строку и столбец шире кадра: нулевые строка и столбец
+// избавляют от проверок на границе. Строится за один проход: строка
+// яркости считается SIMD-ядром PixelKernels::lumaRGB и сразу
+// накапливается в обе таблицы. Суммы яркостей 32-битные (хватает до
+// 16 миллионов пикселей), суммы квадратов 64-битные.
+class IntegralImage {
+    int width, height;
+    PATypes::DynamicArray<uint32_t> sums;
+    PATypes::DynamicArray<uint64_t> squares;
+
+  public:
+    IntegralImage() : width(0), height(0), sums(1), squares(1) {}
+    IntegralImage(const unsigned char *pixels, int width, int height,
+                  int channels)
+        : width(width), height(height),
+          sums((width + 1) * (height + 1)),
+          squares((width + 1) * (height + 1)) {
+        if ((size_t)width * height * 255 > UINT32_MAX)
+            throw std::length_error("кадр слишком велик для интегрального "
+                                    "изображения");
+        PATypes::DynamicArray<unsigned char> luma(width);
+        unsigned char *row = width ? &luma[0] : nullptr;
+        uint32_t *sum = &sums[0];
+        uint64_t *sumSq = &squares[0];
+        size_t stride = width + 1;
+        for (int y = 0; y < height; ++y) {
+            const unsigned char *p = pixels + (size_t)y * width * channels;
+            if (channels == 1) {
+                row = const_cast<unsigned char *>(p);
+            } else if (channels == 3) {
+                PixelKernels::Kernels().lumaRGB(p, row, width);
+            } else {
+                for (int x = 0; x < width; ++x) {
+                    const unsigned char *pixel = p + x * channels;
+                    row[x] = channels < 3
+                                 ? pixel[0]
+                                 : HistogramKernels::Luma(pixel[0], pixel[1],
+                                                          pixel[2]);
+                }
+            }
+            IntegralKernels::AccumulateRow(
+                row, width, sum + y * stride, sum + (y + 1) * stride,
+                sumSq + y * stride, sumSq + (y + 1) * stride);
+        }
+    }
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    // сумма яркостей пикселей с x' < x и y' < y
+    uint32_t Sum(int x, int y) const { return sums[y * (width + 1) + x]; }
+    uint64_t SumSq(int x, int y) const {
+        return squares[y * (width + 1) + x];
+    }
+
+    // сумма яркостей прямоугольника [x, x + w) x [y, y + h)
+    uint32_t RectSum(int x, int y, int w, int h) const {
+        int stride = width + 1;
+        const uint32_t *top = &sums[y * stride + x];
+        const uint32_t *bottom = top + h * stride;
+        return bottom[w] - bottom[0] - top[w] + top[0];
+    }
+    uint64_t RectSumSq(int x, int y, int w, int h) const {
+        int stride = width + 1;
+        const uint64_t *top = &squares[y * stride + x];
+        const uint64_t *bottom = top + h * stride;
+        return bottom[w] - bottom[0] - top[w] + top[0];
+    }
+
+    // Таблицы целиком для обхода без проверок границ: строка y начинается
+    // с элемента y * GetStride()
+    int GetStride() const { return width + 1; }
+    const uint32_t *GetSums() const { return &sums[0]; }
+    const uint64_t *GetSquares() const { return &squares[0]; }
+};
+} // namespace CCTV
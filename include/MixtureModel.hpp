@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include <PATypes/DynamicArray.h>
+
+#include "PixelKernels.hpp"
+#include "RegionMask.hpp"
+#include "ThreadPool.hpp"
+
+namespace CCTV {
+struct MixtureParams {
+    // доля веса, которую кадр отдаёт совпавшей компоненте; около единицы,
+    // делённой на число кадров, которые помнит модель
+    float learningRate = 0.01f;
+    // пиксель совпадает с компонентой в пределах matchSigma сигм
+    float matchSigma = 2.5f;
+    // суммарный вес самых тяжёлых компонент, которые считаются фоном
+    float backgroundWeight = 0.7f;
+    // дисперсия новой компоненты и пределы дисперсии, в уровнях яркости^2
+    float initialVariance = 225.0f;
+    float minVariance = 16.0f;
+    float maxVariance = 5625.0f;
+
+    bool operator==(const MixtureParams &) const = default;
+};
+
+namespace MixtureKernels {
+// Смесь трёх гауссиан на пиксель по яркости, как у Штауффера — Гримсона.
+// Состояние лежит плоскостями (structure of arrays): weight, mean и
+// variance — по три плоскости, компонента k пикселя i — [k * plane + i],
+// так что восемь соседних пикселей одной компоненты загружаются одним
+// регистром AVX2. Порядок компонент не поддерживается, вместо сортировки:
+// - из совпавших компонент берётся самая тяжёлая;
+// - пиксель — фон, если вес компонент тяжелее выбранной меньше
+//   backgroundWeight (порядок по весу вместо w / sigma);
+// - если совпадений нет, самая лёгкая компонента заменяется новой.
+// Скалярный и AVX2-вариант повторяют одни и те же операции над float без
+// FMA и дают одно и то же бит в бит.
+constexpr int Components = 3;
+
+// Отрезок из n пикселей яркости luma; foreground — 255 для пикселей
+// переднего плана, 0 для фона. Возвращает число пикселей переднего плана.
+inline size_t UpdateScalar(const unsigned char *luma, float *weight,
+                           float *mean, float *variance, size_t plane,
+                           size_t n, const MixtureParams &params,
+                           unsigned char *foreground) {
+    const float alpha = params.learningRate, keep = 1.0f - alpha;
+    const float threshold = params.matchSigma * params.matchSigma;
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        float x = luma[i];
+        float w[Components], m[Components], v[Components], d[Components],
+            d2[Components];
+        bool match[Components];
+        for (int k = 0; k < Components; ++k) {
+            w[k] = weight[k * plane + i];
+            m[k] = mean[k * plane + i];
+            v[k] = variance[k * plane + i];
+            d[k] = x - m[k];
+            d2[k] = d[k] * d[k];
+            match[k] = d2[k] < threshold * v[k];
+        }
+        float s0 = match[0] ? w[0] : -1.0f, s1 = match[1] ? w[1] : -1.0f,
+              s2 = match[2] ? w[2] : -1.0f;
+        bool chosen[Components];
+        chosen[0] = s0 >= s1 && s0 >= s2;
+        chosen[1] = !chosen[0] && s1 >= s2;
+        chosen[2] = !chosen[0] && !chosen[1];
+        bool matched = match[0] || match[1] || match[2];
+        float wc = chosen[0] ? w[0] : chosen[1] ? w[1] : w[2];
+        float heavier = (w[0] > wc ? w[0] : 0.0f) + (w[1] > wc ? w[1] : 0.0f);
+        heavier = heavier + (w[2] > wc ? w[2] : 0.0f);
+        bool isForeground = !matched || heavier >= params.backgroundWeight;
+        foreground[i] = isForeground ? 255 : 0;
+        count += isForeground;
+
+        bool lightest[Components];
+        lightest[0] = w[0] <= w[1] && w[0] <= w[2];
+        lightest[1] = !lightest[0] && w[1] <= w[2];
+        lightest[2] = !lightest[0] && !lightest[1];
+        for (int k = 0; k < Components; ++k) {
+            bool hit = matched && chosen[k];
+            w[k] = w[k] * keep + (hit ? alpha : 0.0f);
+            if (hit) {
+                float rho = std::min(1.0f, alpha / w[k]);
+                m[k] = m[k] + rho * d[k];
+                v[k] = std::min(std::max(v[k] + rho * (d2[k] - v[k]),
+                                         params.minVariance),
+                                params.maxVariance);
+            }
+            if (!matched && lightest[k]) {
+                w[k] = alpha;
+                m[k] = x;
+                v[k] = params.initialVariance;
+            }
+        }
+        float sum = w[0] + w[1];
+        sum = sum + w[2];
+        for (int k = 0; k < Components; ++k) {
+            weight[k * plane + i] = w[k] / sum;
+            mean[k * plane + i] = m[k];
+            variance[k * plane + i] = v[k];
+        }
+    }
+    return count;
+}
+
+#ifdef CCTV_X86_KERNELS
+// Восемь пикселей за шаг, ветвления заменены масками сравнений и blendv
+__attribute__((target("avx2"))) inline size_t
+UpdateAVX2(const unsigned char *luma, float *weight, float *mean,
+           float *variance, size_t plane, size_t n,
+           const MixtureParams &params, unsigned char *foreground) {
+    const __m256 alpha = _mm256_set1_ps(params.learningRate);
+    const __m256 keep = _mm256_set1_ps(1.0f - params.learningRate);
+    const __m256 threshold =
+        _mm256_set1_ps(params.matchSigma * params.matchSigma);
+    const __m256 one = _mm256_set1_ps(1.0f), none = _mm256_set1_ps(-1.0f);
+    const __m256 all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    const __m256 backgroundWeight = _mm256_set1_ps(params.backgroundWeight);
+    const __m256 initialVariance = _mm256_set1_ps(params.initialVariance);
+    const __m256 minVariance = _mm256_set1_ps(params.minVariance);
+    const __m256 maxVariance = _mm256_set1_ps(params.maxVariance);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+            _mm_loadl_epi64((const __m128i *)(luma + i))));
+        __m256 w[Components], m[Components], v[Components], d[Components],
+            d2[Components], match[Components];
+        for (int k = 0; k < Components; ++k) {
+            w[k] = _mm256_loadu_ps(weight + k * plane + i);
+            m[k] = _mm256_loadu_ps(mean + k * plane + i);
+            v[k] = _mm256_loadu_ps(variance + k * plane + i);
+            d[k] = _mm256_sub_ps(x, m[k]);
+            d2[k] = _mm256_mul_ps(d[k], d[k]);
+            match[k] = _mm256_cmp_ps(d2[k], _mm256_mul_ps(threshold, v[k]),
+                                     _CMP_LT_OQ);
+        }
+        __m256 s0 = _mm256_blendv_ps(none, w[0], match[0]);
+        __m256 s1 = _mm256_blendv_ps(none, w[1], match[1]);
+        __m256 s2 = _mm256_blendv_ps(none, w[2], match[2]);
+        __m256 chosen[Components];
+        chosen[0] = _mm256_and_ps(_mm256_cmp_ps(s0, s1, _CMP_GE_OQ),
+                                  _mm256_cmp_ps(s0, s2, _CMP_GE_OQ));
+        chosen[1] =
+            _mm256_andnot_ps(chosen[0], _mm256_cmp_ps(s1, s2, _CMP_GE_OQ));
+        chosen[2] = _mm256_andnot_ps(_mm256_or_ps(chosen[0], chosen[1]), all);
+        __m256 matched =
+            _mm256_or_ps(_mm256_or_ps(match[0], match[1]), match[2]);
+        __m256 wc = _mm256_blendv_ps(_mm256_blendv_ps(w[2], w[1], chosen[1]),
+                                     w[0], chosen[0]);
+        __m256 heavier = _mm256_add_ps(
+            _mm256_and_ps(_mm256_cmp_ps(w[0], wc, _CMP_GT_OQ), w[0]),
+            _mm256_and_ps(_mm256_cmp_ps(w[1], wc, _CMP_GT_OQ), w[1]));
+        heavier = _mm256_add_ps(
+            heavier, _mm256_and_ps(_mm256_cmp_ps(w[2], wc, _CMP_GT_OQ), w[2]));
+        __m256 isForeground = _mm256_or_ps(
+            _mm256_andnot_ps(matched, all),
+            _mm256_cmp_ps(heavier, backgroundWeight, _CMP_GE_OQ));
+        unsigned bits = _mm256_movemask_ps(isForeground);
+        for (int j = 0; j < 8; ++j) {
+            foreground[i + j] = (bits >> j) & 1 ? 255 : 0;
+        }
+        count += std::popcount(bits);
+
+        __m256 lightest[Components];
+        lightest[0] = _mm256_and_ps(_mm256_cmp_ps(w[0], w[1], _CMP_LE_OQ),
+                                    _mm256_cmp_ps(w[0], w[2], _CMP_LE_OQ));
+        lightest[1] = _mm256_andnot_ps(lightest[0],
+                                       _mm256_cmp_ps(w[1], w[2], _CMP_LE_OQ));
+        lightest[2] =
+            _mm256_andnot_ps(_mm256_or_ps(lightest[0], lightest[1]), all);
+        for (int k = 0; k < Components; ++k) {
+            __m256 hit = _mm256_and_ps(matched, chosen[k]);
+            w[k] = _mm256_add_ps(_mm256_mul_ps(w[k], keep),
+                                 _mm256_and_ps(hit, alpha));
+            __m256 rho = _mm256_min_ps(one, _mm256_div_ps(alpha, w[k]));
+            __m256 updatedMean = _mm256_add_ps(m[k], _mm256_mul_ps(rho, d[k]));
+            __m256 updatedVariance = _mm256_min_ps(
+                _mm256_max_ps(
+                    _mm256_add_ps(v[k], _mm256_mul_ps(
+                                            rho, _mm256_sub_ps(d2[k], v[k]))),
+                    minVariance),
+                maxVariance);
+            m[k] = _mm256_blendv_ps(m[k], updatedMean, hit);
+            v[k] = _mm256_blendv_ps(v[k], updatedVariance, hit);
+            __m256 replace = _mm256_andnot_ps(matched, lightest[k]);
+            w[k] = _mm256_blendv_ps(w[k], alpha, replace);
+            m[k] = _mm256_blendv_ps(m[k], x, replace);
+            v[k] = _mm256_blendv_ps(v[k], initialVariance, replace);
+        }
+        __m256 sum = _mm256_add_ps(_mm256_add_ps(w[0], w[1]), w[2]);
+        for (int k = 0; k < Components; ++k) {
+            _mm256_storeu_ps(weight + k * plane + i, _mm256_div_ps(w[k], sum));
+            _mm256_storeu_ps(mean + k * plane + i, m[k]);
+            _mm256_storeu_ps(variance + k * plane + i, v[k]);
+        }
+    }
+    return count + UpdateScalar(luma + i, weight + i, mean + i, variance + i,
+                                plane, n - i, params, foreground + i);
+}
+#endif
+
+// SSE2 без blendv идёт скалярным вариантом, AVX-512BW — вариантом AVX2
+inline size_t Update(const unsigned char *luma, float *weight, float *mean,
+                     float *variance, size_t plane, size_t n,
+                     const MixtureParams &params, unsigned char *foreground) {
+#ifdef CCTV_X86_KERNELS
+    if (PixelKernels::GetSimdLevel() >= PixelKernels::SimdLevel::AVX2)
+        return UpdateAVX2(luma, weight, mean, variance, plane, n, params,
+                          foreground);
+#endif
+    return UpdateScalar(luma, weight, mean, variance, plane, n, params,
+                        foreground);
+}
+} // namespace MixtureKernels
+
+// Вычитание фона смесью гауссиан: у каждого пикселя своя смесь
+// MixtureKernels::Components компонент по яркости, так что качающаяся
+// листва, блики на воде и мерцание экранов со временем становятся
+// несколькими режимами фона, а не движением. Кадр обновляет модель за один
+// проход и даёт маску переднего плана; оценка кадра — доля пикселей
+// переднего плана, умноженная на 255, как у остальных оценок. Полосы по
+// BandRows строк независимы и при наличии пула считаются параллельно.
+// RGB-кадры переводятся в яркость построчно ядром lumaRGB. Кадр 1080p
+// стоит 15-18 мс на ядро, поэтому FrameSequence не прогоняет смесь до
+// далёкого кадра по запросу из UI (TryGetScore), это делает PrecalcJob.
+class MixtureModel {
+    MixtureParams params;
+    int width, height;
+    size_t frameCount;
+    // по Components плоскостей width * height
+    PATypes::DynamicArray<float> weights, means, variances;
+    PATypes::DynamicArray<unsigned char> foreground;
+    double foregroundFraction;
+
+    size_t GetPlane() const { return (size_t)width * height; }
+
+    void Init(const unsigned char *pixels, int channels) {
+        size_t plane = GetPlane();
+        weights.resize(MixtureKernels::Components * plane);
+        means.resize(MixtureKernels::Components * plane);
+        variances.resize(MixtureKernels::Components * plane);
+        foreground.resize(plane);
+        PATypes::DynamicArray<unsigned char> row(std::max(1, width));
+        for (int y = 0; y < height; ++y) {
+            const unsigned char *luma = GetLumaRow(pixels, channels, y, &row[0]);
+            for (int x = 0; x < width; ++x) {
+                size_t i = (size_t)y * width + x;
+                for (int k = 0; k < MixtureKernels::Components; ++k) {
+                    weights[k * plane + i] = k ? 0.0f : 1.0f;
+                    means[k * plane + i] = k ? 0.0f : (float)luma[x];
+                    variances[k * plane + i] = params.initialVariance;
+                }
+                foreground[i] = 0;
+            }
+        }
+    }
+
+    const unsigned char *GetLumaRow(const unsigned char *pixels, int channels,
+                                    int y, unsigned char *row) const {
+        if (channels == 1)
+            return pixels + (size_t)y * width;
+        PixelKernels::Kernels().lumaRGB(pixels + (size_t)y * width * 3, row,
+                                        width);
+        return row;
+    }
+
+    size_t UpdateRange(const unsigned char *luma, size_t offset, size_t n) {
+        return MixtureKernels::Update(luma, &weights[offset], &means[offset],
+                                      &variances[offset], GetPlane(), n,
+                                      params, &foreground[offset]);
+    }
+
+  public:
+    static constexpr int BandRows = 16;
+
+    MixtureModel(const MixtureParams &params = MixtureParams())
+        : params(params), width(0), height(0), frameCount(0), weights(0),
+          means(0), variances(0), foreground(0), foregroundFraction(0) {}
+
+    const MixtureParams &GetParams() const { return params; }
+    size_t GetFrameCount() const { return frameCount; }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+
+    // Доля пикселей переднего плана в последнем кадре (по маске — среди её
+    // пикселей) на шкале 0..255 и обновление модели этим кадром. Первый
+    // кадр и кадр другого размера начинают модель заново и дают 0.
+    // channels — 1 (яркость) или 3 (RGB24). Маска должна оставаться той
+    // же, пока модель не начата заново.
+    double Update(const unsigned char *pixels, int width, int height,
+                  int channels, const RegionMask *mask = nullptr,
+                  ThreadPool *pool = nullptr) {
+        if (channels != 1 && channels != 3)
+            throw std::invalid_argument(
+                "смесь гауссиан считается по яркости или RGB24");
+        if (mask && (mask->GetWidth() != width || mask->GetHeight() != height))
+            throw std::logic_error("маска не совпадает с кадром");
+        ++frameCount;
+        if (frameCount == 1 || width != this->width ||
+            height != this->height) {
+            this->width = width;
+            this->height = height;
+            Init(pixels, channels);
+            foregroundFraction = 0;
+            return 0;
+        }
+        int bandCount = (height + BandRows - 1) / BandRows;
+        PATypes::DynamicArray<size_t> counts(std::max(1, bandCount));
+        auto band = [&](int index) {
+            PATypes::DynamicArray<unsigned char> row(std::max(1, width));
+            size_t count = 0;
+            int to = std::min(height, (index + 1) * BandRows);
+            for (int y = index * BandRows; y < to; ++y) {
+                if (mask && !mask->GetRowSpanCount(y))
+                    continue;
+                const unsigned char *luma =
+                    GetLumaRow(pixels, channels, y, &row[0]);
+                size_t offset = (size_t)y * width;
+                if (!mask) {
+                    count += UpdateRange(luma, offset, width);
+                    continue;
+                }
+                const MaskSpan *spans = mask->GetRowSpans(y);
+                for (int i = 0; i < mask->GetRowSpanCount(y); ++i) {
+                    count += UpdateRange(luma + spans[i].from,
+                                         offset + spans[i].from,
+                                         spans[i].to - spans[i].from);
+                }
+            }
+            counts[index] = count;
+        };
+        if (pool) {
+            pool->ParallelFor(0, bandCount, band);
+        } else {
+            for (int i = 0; i < bandCount; ++i) {
+                band(i);
+            }
+        }
+        size_t count = 0;
+        for (int i = 0; i < bandCount; ++i) {
+            count += counts[i];
+        }
+        size_t total = mask ? mask->GetPixelCount() : GetPlane();
+        foregroundFraction = total ? (double)count / total : 0;
+        return foregroundFraction * 255;
+    }
+
+    // Маска переднего плана последнего кадра, width * height байт: 255 —
+    // передний план, 0 — фон и пиксели вне маски области интереса
+    const unsigned char *GetForeground() const {
+        return frameCount ? &foreground[0] : nullptr;
+    }
+    double GetForegroundFraction() const { return foregroundFraction; }
+};
+} // namespace CCTV
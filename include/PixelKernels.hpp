@@ -0,0 +1,555 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CCTV_X86_KERNELS 1
+#endif
+
+namespace CCTV {
+namespace PixelKernels {
+// Побайтовые операции над пикселями кадра. Каждая операция есть в
+// скалярном варианте и в вариантах под SSE2, AVX2 и AVX-512BW; вариант
+// выбирается один раз при первом обращении по cpuid, так что бинарник
+// собирается без -march и работает на любом x86-64.
+enum class SimdLevel { Scalar, SSE2, AVX2, AVX512BW };
+
+struct KernelTable {
+    SimdLevel level;
+    // сумма модулей разностей
+    uint64_t (*sumAbsDiff)(const unsigned char *a, const unsigned char *b,
+                           size_t n);
+    // сумма байт
+    uint64_t (*sum)(const unsigned char *a, size_t n);
+    void (*absDiff)(const unsigned char *a, const unsigned char *b,
+                    unsigned char *out, size_t n);
+    void (*bitXor)(const unsigned char *a, const unsigned char *b,
+                   unsigned char *out, size_t n);
+    void (*bitAnd)(const unsigned char *a, const unsigned char *b,
+                   unsigned char *out, size_t n);
+    // яркость (77R + 150G + 29B + 128) >> 8 для pixels пикселей RGB24
+    void (*lumaRGB)(const unsigned char *rgb, unsigned char *out,
+                    size_t pixels);
+    // среднее с округлением вверх (a + b + 1) >> 1, как pavgb
+    void (*average)(const unsigned char *a, const unsigned char *b,
+                    unsigned char *out, size_t n);
+};
+
+inline const char *GetSimdLevelName(SimdLevel level) {
+    switch (level) {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::SSE2:
+        return "sse2";
+    case SimdLevel::AVX2:
+        return "avx2";
+    case SimdLevel::AVX512BW:
+        return "avx512bw";
+    }
+    return "unknown";
+}
+
+inline SimdLevel ParseSimdLevel(const std::string &name) {
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2,
+                            SimdLevel::AVX2, SimdLevel::AVX512BW}) {
+        if (name == GetSimdLevelName(level))
+            return level;
+    }
+    throw std::invalid_argument("неизвестный уровень SIMD: " + name);
+}
+
+inline uint64_t SumAbsDiffScalar(const unsigned char *a, const unsigned char *b,
+                                 size_t n) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < n; ++i) {
+        result += (unsigned)std::abs((int)a[i] - b[i]);
+    }
+    return result;
+}
+
+inline uint64_t SumScalar(const unsigned char *a, size_t n) {
+    uint64_t result = 0;
+    for (size_t i = 0; i < n; ++i) {
+        result += a[i];
+    }
+    return result;
+}
+
+inline void AbsDiffScalar(const unsigned char *a, const unsigned char *b,
+                          unsigned char *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = std::abs((int)a[i] - b[i]);
+    }
+}
+
+inline void XorScalar(const unsigned char *a, const unsigned char *b,
+                      unsigned char *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] ^ b[i];
+    }
+}
+
+inline void AndScalar(const unsigned char *a, const unsigned char *b,
+                      unsigned char *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = a[i] & b[i];
+    }
+}
+
+inline void AverageScalar(const unsigned char *a, const unsigned char *b,
+                          unsigned char *out, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = (a[i] + b[i] + 1) >> 1;
+    }
+}
+
+inline void LumaRGBScalar(const unsigned char *rgb, unsigned char *out,
+                          size_t pixels) {
+    for (size_t i = 0; i < pixels; ++i) {
+        const unsigned char *p = rgb + i * 3;
+        out[i] = (77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8;
+    }
+}
+
+#ifdef CCTV_X86_KERNELS
+__attribute__((target("avx512f"))) inline uint64_t
+ReduceAddAVX512(__m512i acc) {
+    uint64_t lanes[8];
+    _mm512_storeu_si512((void *)lanes, acc);
+    uint64_t result = 0;
+    for (uint64_t lane : lanes) {
+        result += lane;
+    }
+    return result;
+}
+
+// psadbw складывает модули разностей восьми байт сразу в 64-битную сумму,
+// поэтому промежуточный кадр с дельтой не нужен
+__attribute__((target("sse2"))) inline uint64_t
+SumAbsDiffSSE2(const unsigned char *a, const unsigned char *b, size_t n) {
+    __m128i acc0 = _mm_setzero_si128();
+    __m128i acc1 = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i a1 = _mm_loadu_si128((const __m128i *)(a + i + 16));
+        __m128i b1 = _mm_loadu_si128((const __m128i *)(b + i + 16));
+        acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(a0, b0));
+        acc1 = _mm_add_epi64(acc1, _mm_sad_epu8(a1, b1));
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(b + i));
+        acc0 = _mm_add_epi64(acc0, _mm_sad_epu8(a0, b0));
+    }
+    acc0 = _mm_add_epi64(acc0, acc1);
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc0);
+    return lanes[0] + lanes[1] + SumAbsDiffScalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2"))) inline uint64_t
+SumSSE2(const unsigned char *a, size_t n) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(a + i));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(a0, zero));
+    }
+    uint64_t lanes[2];
+    _mm_storeu_si128((__m128i *)lanes, acc);
+    return lanes[0] + lanes[1] + SumScalar(a + i, n - i);
+}
+
+__attribute__((target("sse2"))) inline void
+AbsDiffSSE2(const unsigned char *a, const unsigned char *b, unsigned char *out,
+            size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i d = _mm_or_si128(_mm_subs_epu8(a0, b0), _mm_subs_epu8(b0, a0));
+        _mm_storeu_si128((__m128i *)(out + i), d);
+    }
+    AbsDiffScalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("sse2"))) inline void
+XorSSE2(const unsigned char *a, const unsigned char *b, unsigned char *out,
+        size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_xor_si128(a0, b0));
+    }
+    XorScalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("sse2"))) inline void
+AndSSE2(const unsigned char *a, const unsigned char *b, unsigned char *out,
+        size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_and_si128(a0, b0));
+    }
+    AndScalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("sse2"))) inline void
+AverageSSE2(const unsigned char *a, const unsigned char *b, unsigned char *out,
+            size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i b0 = _mm_loadu_si128((const __m128i *)(b + i));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_avg_epu8(a0, b0));
+    }
+    AverageScalar(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline uint64_t
+SumAbsDiffAVX2(const unsigned char *a, const unsigned char *b, size_t n) {
+    __m256i acc0 = _mm256_setzero_si256();
+    __m256i acc1 = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(a + i + 32));
+        __m256i b1 = _mm256_loadu_si256((const __m256i *)(b + i + 32));
+        acc0 = _mm256_add_epi64(acc0, _mm256_sad_epu8(a0, b0));
+        acc1 = _mm256_add_epi64(acc1, _mm256_sad_epu8(a1, b1));
+    }
+    acc0 = _mm256_add_epi64(acc0, acc1);
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc0);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+           SumAbsDiffSSE2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline uint64_t
+SumAVX2(const unsigned char *a, size_t n) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(a0, zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + SumSSE2(a + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+AbsDiffAVX2(const unsigned char *a, const unsigned char *b, unsigned char *out,
+            size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i d = _mm256_or_si256(_mm256_subs_epu8(a0, b0),
+                                    _mm256_subs_epu8(b0, a0));
+        _mm256_storeu_si256((__m256i *)(out + i), d);
+    }
+    AbsDiffSSE2(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+XorAVX2(const unsigned char *a, const unsigned char *b, unsigned char *out,
+        size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_xor_si256(a0, b0));
+    }
+    XorSSE2(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+AndAVX2(const unsigned char *a, const unsigned char *b, unsigned char *out,
+        size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_and_si256(a0, b0));
+    }
+    AndSSE2(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void
+AverageAVX2(const unsigned char *a, const unsigned char *b, unsigned char *out,
+            size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i b0 = _mm256_loadu_si256((const __m256i *)(b + i));
+        _mm256_storeu_si256((__m256i *)(out + i), _mm256_avg_epu8(a0, b0));
+    }
+    AverageSSE2(a + i, b + i, out + i, n - i);
+}
+
+// pshufb раскладывает 48 байт RGBRGB... (по 16 пикселей в каждой половине
+// регистра) на отдельные R, G и B, дальше взвешенная сумма в 16 битах:
+// максимум 256 * 255 + 128 в 16 бит без знака помещается. Вариантов под
+// SSE2 нет (pshufb — SSSE3), этот же используется и для AVX-512BW.
+__attribute__((target("avx2"))) inline __m256i
+LoadRGBChunksAVX2(const unsigned char *p) {
+    return _mm256_inserti128_si256(
+        _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p)),
+        _mm_loadu_si128((const __m128i *)(p + 48)), 1);
+}
+
+__attribute__((target("avx2"))) inline __m256i
+WeighLumaAVX2(__m256i r, __m256i g, __m256i b) {
+    __m256i sum = _mm256_mullo_epi16(r, _mm256_set1_epi16(77));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(g, _mm256_set1_epi16(150)));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(29)));
+    sum = _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(sum, 8);
+}
+
+__attribute__((target("avx2"))) inline void
+LumaRGBAVX2(const unsigned char *rgb, unsigned char *out, size_t pixels) {
+    const __m256i takeR0 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m256i takeR1 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1));
+    const __m256i takeR2 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13));
+    const __m256i takeG0 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m256i takeG1 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1));
+    const __m256i takeG2 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14));
+    const __m256i takeB0 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m256i takeB1 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1));
+    const __m256i takeB2 = _mm256_broadcastsi128_si256(_mm_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15));
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= pixels; i += 32) {
+        const unsigned char *p = rgb + i * 3;
+        __m256i c0 = LoadRGBChunksAVX2(p), c1 = LoadRGBChunksAVX2(p + 16),
+                c2 = LoadRGBChunksAVX2(p + 32);
+        __m256i r = _mm256_or_si256(
+            _mm256_or_si256(_mm256_shuffle_epi8(c0, takeR0),
+                            _mm256_shuffle_epi8(c1, takeR1)),
+            _mm256_shuffle_epi8(c2, takeR2));
+        __m256i g = _mm256_or_si256(
+            _mm256_or_si256(_mm256_shuffle_epi8(c0, takeG0),
+                            _mm256_shuffle_epi8(c1, takeG1)),
+            _mm256_shuffle_epi8(c2, takeG2));
+        __m256i b = _mm256_or_si256(
+            _mm256_or_si256(_mm256_shuffle_epi8(c0, takeB0),
+                            _mm256_shuffle_epi8(c1, takeB1)),
+            _mm256_shuffle_epi8(c2, takeB2));
+        __m256i low = WeighLumaAVX2(_mm256_unpacklo_epi8(r, zero),
+                                    _mm256_unpacklo_epi8(g, zero),
+                                    _mm256_unpacklo_epi8(b, zero));
+        __m256i high = WeighLumaAVX2(_mm256_unpackhi_epi8(r, zero),
+                                     _mm256_unpackhi_epi8(g, zero),
+                                     _mm256_unpackhi_epi8(b, zero));
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            _mm256_packus_epi16(low, high));
+    }
+    LumaRGBScalar(rgb + i * 3, out + i, pixels - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline uint64_t
+SumAbsDiffAVX512(const unsigned char *a, const unsigned char *b, size_t n) {
+    __m512i acc0 = _mm512_setzero_si512();
+    __m512i acc1 = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        __m512i a0 = _mm512_loadu_si512((const void *)(a + i));
+        __m512i b0 = _mm512_loadu_si512((const void *)(b + i));
+        __m512i a1 = _mm512_loadu_si512((const void *)(a + i + 64));
+        __m512i b1 = _mm512_loadu_si512((const void *)(b + i + 64));
+        acc0 = _mm512_add_epi64(acc0, _mm512_sad_epu8(a0, b0));
+        acc1 = _mm512_add_epi64(acc1, _mm512_sad_epu8(a1, b1));
+    }
+    return ReduceAddAVX512(_mm512_add_epi64(acc0, acc1)) +
+           SumAbsDiffAVX2(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline uint64_t
+SumAVX512(const unsigned char *a, size_t n) {
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i a0 = _mm512_loadu_si512((const void *)(a + i));
+        acc = _mm512_add_epi64(acc, _mm512_sad_epu8(a0, zero));
+    }
+    return ReduceAddAVX512(acc) + SumAVX2(a + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline void
+AbsDiffAVX512(const unsigned char *a, const unsigned char *b,
+              unsigned char *out, size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i a0 = _mm512_loadu_si512((const void *)(a + i));
+        __m512i b0 = _mm512_loadu_si512((const void *)(b + i));
+        __m512i d = _mm512_or_si512(_mm512_subs_epu8(a0, b0),
+                                    _mm512_subs_epu8(b0, a0));
+        _mm512_storeu_si512((void *)(out + i), d);
+    }
+    AbsDiffAVX2(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline void
+XorAVX512(const unsigned char *a, const unsigned char *b, unsigned char *out,
+          size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i a0 = _mm512_loadu_si512((const void *)(a + i));
+        __m512i b0 = _mm512_loadu_si512((const void *)(b + i));
+        _mm512_storeu_si512((void *)(out + i), _mm512_xor_si512(a0, b0));
+    }
+    XorAVX2(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline void
+AndAVX512(const unsigned char *a, const unsigned char *b, unsigned char *out,
+          size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i a0 = _mm512_loadu_si512((const void *)(a + i));
+        __m512i b0 = _mm512_loadu_si512((const void *)(b + i));
+        _mm512_storeu_si512((void *)(out + i), _mm512_and_si512(a0, b0));
+    }
+    AndAVX2(a + i, b + i, out + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline void
+AverageAVX512(const unsigned char *a, const unsigned char *b,
+              unsigned char *out, size_t n) {
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i a0 = _mm512_loadu_si512((const void *)(a + i));
+        __m512i b0 = _mm512_loadu_si512((const void *)(b + i));
+        _mm512_storeu_si512((void *)(out + i), _mm512_avg_epu8(a0, b0));
+    }
+    AverageAVX2(a + i, b + i, out + i, n - i);
+}
+#endif
+
+inline const KernelTable &GetKernelTable(SimdLevel level) {
+    static const KernelTable scalar = {
+        SimdLevel::Scalar, SumAbsDiffScalar, SumScalar,
+        AbsDiffScalar,     XorScalar,        AndScalar,
+        LumaRGBScalar,     AverageScalar};
+#ifdef CCTV_X86_KERNELS
+    static const KernelTable sse2 = {
+        SimdLevel::SSE2, SumAbsDiffSSE2, SumSSE2,      AbsDiffSSE2,
+        XorSSE2,         AndSSE2,        LumaRGBScalar, AverageSSE2};
+    static const KernelTable avx2 = {
+        SimdLevel::AVX2, SumAbsDiffAVX2, SumAVX2,    AbsDiffAVX2,
+        XorAVX2,         AndAVX2,        LumaRGBAVX2, AverageAVX2};
+    static const KernelTable avx512 = {
+        SimdLevel::AVX512BW, SumAbsDiffAVX512, SumAVX512,  AbsDiffAVX512,
+        XorAVX512,           AndAVX512,        LumaRGBAVX2, AverageAVX512};
+    switch (level) {
+    case SimdLevel::SSE2:
+        return sse2;
+    case SimdLevel::AVX2:
+        return avx2;
+    case SimdLevel::AVX512BW:
+        return avx512;
+    default:
+        break;
+    }
+#endif
+    return scalar;
+}
+
+inline bool IsSimdLevelSupported(SimdLevel level) {
+#ifdef CCTV_X86_KERNELS
+    switch (level) {
+    case SimdLevel::Scalar:
+        return true;
+    case SimdLevel::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case SimdLevel::AVX2:
+        return __builtin_cpu_supports("avx2");
+    case SimdLevel::AVX512BW:
+        return __builtin_cpu_supports("avx512f") &&
+               __builtin_cpu_supports("avx512bw");
+    }
+    return false;
+#else
+    return level == SimdLevel::Scalar;
+#endif
+}
+
+inline SimdLevel DetectSimdLevel() {
+    for (SimdLevel level : {SimdLevel::AVX512BW, SimdLevel::AVX2,
+                            SimdLevel::SSE2}) {
+        if (IsSimdLevelSupported(level))
+            return level;
+    }
+    return SimdLevel::Scalar;
+}
+
+// Текущая таблица. Уровень по умолчанию — лучший из поддерживаемых
+// процессором; переменная окружения CCTV_SIMD=scalar|sse2|avx2|avx512bw
+// принудительно задаёт его (например, для сравнения в бенчмарках).
+// Неизвестное или не поддерживаемое значение не ошибка: остаётся уровень
+// по умолчанию, неизвестное — с одним предупреждением в stderr. Бросает
+// только ForceSimdLevel.
+inline std::atomic<const KernelTable *> &CurrentKernelTable() {
+    static std::atomic<const KernelTable *> current = [] {
+        SimdLevel level = DetectSimdLevel();
+        if (const char *forced = std::getenv("CCTV_SIMD")) {
+            try {
+                SimdLevel requested = ParseSimdLevel(forced);
+                if (IsSimdLevelSupported(requested))
+                    level = requested;
+            } catch (const std::invalid_argument &e) {
+                fprintf(stderr, "CCTV_SIMD: %s, используется %s\n", e.what(),
+                        GetSimdLevelName(level));
+            }
+        }
+        return &GetKernelTable(level);
+    }();
+    return current;
+}
+
+inline const KernelTable &Kernels() { return *CurrentKernelTable().load(); }
+
+inline SimdLevel GetSimdLevel() { return Kernels().level; }
+
+inline void ForceSimdLevel(SimdLevel level) {
+    if (!IsSimdLevelSupported(level))
+        throw std::invalid_argument(
+            std::string("процессор не поддерживает уровень SIMD ") +
+            GetSimdLevelName(level));
+    CurrentKernelTable().store(&GetKernelTable(level));
+}
+
+// Сумма модулей разностей n байт за один проход только на чтение
+inline uint64_t SumAbsDiff(const unsigned char *a, const unsigned char *b,
+                           size_t n) {
+    return Kernels().sumAbsDiff(a, b, n);
+}
+} // namespace PixelKernels
+} // namespace CCTV
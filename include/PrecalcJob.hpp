@@ -0,0 +1,170 @@
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include <PATypes/Sequence.h>
+
+#include "Frame.hpp"
+#include "Score.hpp"
+
+namespace CCTV {
+// PrecalcScore в фоновом потоке. Задача считает на копии последовательности:
+// кадры при копировании делят пиксели с исходными, так что снимок дешёвый,
+// а исходная последовательность остаётся в распоряжении потока UI. Готовые
+// оценки копятся блоками, Collect переносит их в исходную
+// последовательность и расставляет метки уже в потоке UI.
+class PrecalcJob {
+    // оценка кадра и его средняя яркость для меток вспышек
+    struct ReadyScore {
+        int index;
+        double score;
+        double brightness;
+    };
+
+    FrameSequence snapshot;
+    int frameCount;
+    int windowLength;
+    float treshold;
+    float leapTreshold;
+    float flashTreshold;
+    ScoreMode scoreMode;
+    HistogramMetric histogramMetric;
+    int analysisScale;
+    int tileSize;
+    std::shared_ptr<const RegionMask> mask;
+    MixtureParams mixtureParams;
+    ScoreTagger tagger;
+
+    std::mutex mutex;
+    PATypes::MutableArraySequence<ReadyScore> ready;
+    std::exception_ptr error;
+    std::atomic<int> done;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> finished;
+    bool merged;
+    std::thread worker;
+
+    void Run() {
+        try {
+            PATypes::MutableArraySequence<ReadyScore> block;
+            snapshot.PrecalcScores(
+                [this, &block](int r, double score) {
+                    block.append(ReadyScore{r, score, snapshot.GetBrightness(r)});
+                },
+                [this, &block](int processed) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        for (int i = 0; i < block.getLength(); ++i) {
+                            ready.append(block.Getrvalue(i));
+                        }
+                    }
+                    block = PATypes::MutableArraySequence<ReadyScore>();
+                    done = processed;
+                    return !cancelled;
+                },
+                [this] { return (bool)cancelled; });
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            error = std::current_exception();
+        }
+        finished = true;
+    }
+
+  public:
+    // Сбрасывает оценки и метки frames и запускает расчёт с текущими
+    // параметрами последовательности
+    PrecalcJob(FrameSequence &frames)
+        : snapshot(frames), frameCount(frames.getLength()),
+          windowLength(frames.GetWindow()), treshold(frames.GetTreshold()),
+          leapTreshold(frames.GetLeapTreshold()),
+          flashTreshold(frames.GetFlashTreshold()),
+          scoreMode(frames.GetScoreMode()),
+          histogramMetric(frames.GetHistogramMetric()),
+          analysisScale(frames.GetAnalysisScale()),
+          tileSize(frames.GetTileSize()), mask(frames.GetMask()),
+          mixtureParams(frames.GetMixtureParams()),
+          tagger(treshold, leapTreshold, flashTreshold), done(0), cancelled(false),
+          finished(false), merged(false) {
+        snapshot.SetPrecalcThreads(frames.GetPrecalcThreads());
+        frames.ClearScores();
+        worker = std::thread([this] { Run(); });
+    }
+    PrecalcJob(const PrecalcJob &) = delete;
+    PrecalcJob &operator=(const PrecalcJob &) = delete;
+    ~PrecalcJob() {
+        Cancel();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    // Расчёт прервётся после текущего кадра или дельты пары
+    void Cancel() { cancelled = true; }
+    bool IsCancelled() const { return cancelled; }
+    bool IsFinished() const { return finished; }
+    int GetFrameCount() const { return frameCount; }
+    float GetProgress() const {
+        return frameCount ? (float)done / frameCount : 1.0f;
+    }
+
+    // Посчитаны ли дельты пар тем же способом, что сейчас у frames
+    bool SameDeltas(FrameSequence &frames) {
+        return scoreMode == frames.GetScoreMode() &&
+               histogramMetric == frames.GetHistogramMetric() &&
+               analysisScale == frames.GetAnalysisScale() &&
+               tileSize == frames.GetTileSize() && mask == frames.GetMask() &&
+               mixtureParams == frames.GetMixtureParams();
+    }
+    // Посчитана ли задача для тех же параметров, что сейчас у frames
+    bool Matches(FrameSequence &frames) {
+        return SameDeltas(frames) && windowLength == frames.GetWindow() &&
+               treshold == frames.GetTreshold() &&
+               leapTreshold == frames.GetLeapTreshold() &&
+               flashTreshold == frames.GetFlashTreshold();
+    }
+
+    // Переносит готовые оценки в frames; вызывается из потока UI с той же
+    // последовательностью, что была передана в конструктор. Когда задача
+    // закончилась, переносит и дельты пар, чтобы следующий расчёт их не
+    // повторял. Возвращает true, если задача закончилась; ошибка расчёта
+    // пробрасывается здесь.
+    bool Collect(FrameSequence &frames) {
+        bool complete = finished;
+        PATypes::MutableArraySequence<ReadyScore> scores;
+        std::exception_ptr failure;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            scores = std::move(ready);
+            ready = PATypes::MutableArraySequence<ReadyScore>();
+            failure = error;
+        }
+        // после смены окна или порогов оценки уже не годятся, а дельты
+        // пар — да, пока не сменился режим оценки
+        for (int i = 0; Matches(frames) && i < scores.getLength(); ++i) {
+            ReadyScore &score = scores.Getrvalue(i);
+            if (score.index < frames.getLength())
+                frames.AddScore(score.index, score.score, tagger,
+                                score.brightness);
+        }
+        if (complete && !merged) {
+            merged = true;
+            if (SameDeltas(frames))
+                frames.MergePairs(snapshot);
+        }
+        if (failure)
+            std::rethrow_exception(failure);
+        return complete;
+    }
+
+    // Останавливает расчёт и забирает всё, что успело посчитаться. Ждёт
+    // только текущий кадр, поэтому годится для потока UI.
+    void Stop(FrameSequence &frames) {
+        Cancel();
+        if (worker.joinable())
+            worker.join();
+        Collect(frames);
+    }
+};
+} // namespace CCTV
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#include "PixelKernels.hpp"
+
+namespace CCTV {
+namespace PyramidKernels {
+// Уровень пирамиды — среднее квадрата 2x2 пикселей. Сначала строки
+// усредняются попарно ядром PixelKernels::average, затем соседние пиксели
+// полученной строки: out = avg(avg(a0, b0), avg(a1, b1)), avg как у pavgb
+// с округлением вверх. От точного (a0 + a1 + b0 + b1 + 2) >> 2 отличается
+// не больше чем на единицу, зато scalar и SIMD дают одно и то же.
+
+// Соседние пиксели строки из 2 * width пикселей по channels байт
+inline void AveragePairsScalar(const unsigned char *row, size_t width,
+                               int channels, unsigned char *out) {
+    for (size_t x = 0; x < width; ++x) {
+        const unsigned char *left = row + 2 * x * channels;
+        for (int c = 0; c < channels; ++c) {
+            out[x * channels + c] = (left[c] + left[channels + c] + 1) >> 1;
+        }
+    }
+}
+
+#ifdef CCTV_X86_KERNELS
+// Один канал: чётные и нечётные байты расходятся по 16-битным полосам
+// маской и сдвигом, pavgw усредняет их, packus собирает 16 байт результата
+// из 32 байт строки
+__attribute__((target("sse2"))) inline void
+AveragePairsGraySSE2(const unsigned char *row, size_t width,
+                     unsigned char *out) {
+    const __m128i low = _mm_set1_epi16(0x00FF);
+    size_t x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(row + 2 * x));
+        __m128i b = _mm_loadu_si128((const __m128i *)(row + 2 * x + 16));
+        __m128i first = _mm_avg_epu16(_mm_and_si128(a, low),
+                                      _mm_srli_epi16(a, 8));
+        __m128i second = _mm_avg_epu16(_mm_and_si128(b, low),
+                                       _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((__m128i *)(out + x),
+                         _mm_packus_epi16(first, second));
+    }
+    AveragePairsScalar(row + 2 * x, width - x, 1, out + x);
+}
+
+// RGB24: за шаг восемь пикселей строки (24 байта) в четыре. pshufb
+// собирает чётные и нечётные пиксели из двух перекрывающихся загрузок
+// [0, 16) и [8, 24), pavgb усредняет их, 12 байт результата пишутся
+// восемью и четырьмя байтами
+__attribute__((target("ssse3"))) inline void
+AveragePairsRGBSSSE3(const unsigned char *row, size_t width,
+                     unsigned char *out) {
+    const __m128i evenLow =
+        _mm_setr_epi8(0, 1, 2, 6, 7, 8, 12, 13, 14, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i evenHigh =
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, 10, 11, 12, -1, -1, -1, -1);
+    const __m128i oddLow =
+        _mm_setr_epi8(3, 4, 5, 9, 10, 11, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i oddHigh =
+        _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, 8, 9, 13, 14, 15, -1, -1, -1, -1);
+    size_t x = 0;
+    for (; x + 4 <= width; x += 4) {
+        const unsigned char *p = row + 6 * x;
+        __m128i low = _mm_loadu_si128((const __m128i *)p);
+        __m128i high = _mm_loadu_si128((const __m128i *)(p + 8));
+        __m128i even = _mm_or_si128(_mm_shuffle_epi8(low, evenLow),
+                                    _mm_shuffle_epi8(high, evenHigh));
+        __m128i odd = _mm_or_si128(_mm_shuffle_epi8(low, oddLow),
+                                   _mm_shuffle_epi8(high, oddHigh));
+        __m128i result = _mm_avg_epu8(even, odd);
+        _mm_storel_epi64((__m128i *)(out + 3 * x), result);
+        int tail = _mm_cvtsi128_si32(_mm_srli_si128(result, 8));
+        memcpy(out + 3 * x + 8, &tail, 4);
+    }
+    AveragePairsScalar(row + 6 * x, width - x, 3, out + 3 * x);
+}
+#endif
+
+inline void AveragePairs(const unsigned char *row, size_t width, int channels,
+                         unsigned char *out) {
+#ifdef CCTV_X86_KERNELS
+    if (channels == 1 &&
+        PixelKernels::GetSimdLevel() != PixelKernels::SimdLevel::Scalar) {
+        AveragePairsGraySSE2(row, width, out);
+        return;
+    }
+    // SSSE3 есть у всех процессоров с AVX2
+    if (channels == 3 &&
+        PixelKernels::GetSimdLevel() >= PixelKernels::SimdLevel::AVX2) {
+        AveragePairsRGBSSSE3(row, width, out);
+        return;
+    }
+#endif
+    AveragePairsScalar(row, width, channels, out);
+}
+
+// Строка уровня шириной width из строк top и bottom предыдущего уровня;
+// scratch — не меньше 2 * width * channels байт
+inline void HalveRow(const unsigned char *top, const unsigned char *bottom,
+                     size_t width, int channels, unsigned char *scratch,
+                     unsigned char *out) {
+    PixelKernels::Kernels().average(top, bottom, scratch,
+                                    2 * width * channels);
+    AveragePairs(scratch, width, channels, out);
+}
+} // namespace PyramidKernels
+} // namespace CCTV
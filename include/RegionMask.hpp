@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+
+#include <PATypes/DynamicArray.h>
+
+namespace CCTV {
+// Включённые пиксели строки: [from, to)
+struct MaskSpan {
+    int from, to;
+};
+
+// Маска области интереса кадра: в каждой строке — упорядоченные
+// непересекающиеся отрезки включённых пикселей (run-length). Оценки по
+// маске проходят только по отрезкам, исключённые пиксели не читаются
+// вовсе, так что камера, у которой 70% вида закрыто маской, обходится
+// примерно в 30% вычислений. Отрезки всех строк лежат подряд в одном
+// массиве, rowStart[y] — индекс первого отрезка строки y.
+class RegionMask {
+    int width, height;
+    PATypes::DynamicArray<int> rowStart;
+    PATypes::DynamicArray<MaskSpan> spans;
+    size_t pixelCount;
+
+    // Пересобирает строки [fromRow, toRow): отрезки каждой из них заменяет
+    // edit(старые отрезки, их число, куда писать), возвращающий число
+    // записанных
+    template <class F> void RewriteRows(int fromRow, int toRow, F &&edit) {
+        PATypes::DynamicArray<int> newStart(height + 1);
+        PATypes::DynamicArray<MaskSpan> newSpans(0);
+        // в строку после правки отрезков не больше, чем было, плюс один
+        PATypes::DynamicArray<MaskSpan> row(1);
+        int count = 0;
+        pixelCount = 0;
+        for (int y = 0; y < height; ++y) {
+            newStart[y] = count;
+            const MaskSpan *old = GetRowSpans(y);
+            int oldCount = GetRowSpanCount(y);
+            int written = oldCount;
+            const MaskSpan *source = old;
+            if (y >= fromRow && y < toRow) {
+                row.resize(oldCount + 1);
+                written = edit(old, oldCount, &row[0]);
+                source = written ? &row[0] : nullptr;
+            }
+            newSpans.resize(count + written);
+            for (int i = 0; i < written; ++i) {
+                newSpans[count + i] = source[i];
+                pixelCount += source[i].to - source[i].from;
+            }
+            count += written;
+        }
+        newStart[height] = count;
+        rowStart = std::move(newStart);
+        spans = std::move(newSpans);
+    }
+
+    // Пересечение упорядоченных отрезков a и b в out, возвращает число
+    static int Intersect(const MaskSpan *a, int aCount, const MaskSpan *b,
+                         int bCount, MaskSpan *out) {
+        int count = 0;
+        for (int i = 0, j = 0; i < aCount && j < bCount;) {
+            int from = std::max(a[i].from, b[j].from);
+            int to = std::min(a[i].to, b[j].to);
+            if (from < to)
+                out[count++] = {from, to};
+            if (a[i].to < b[j].to)
+                ++i;
+            else
+                ++j;
+        }
+        return count;
+    }
+
+  public:
+    // included — вся ли маска включена изначально
+    RegionMask(int width = 0, int height = 0, bool included = true)
+        : width(width), height(height), rowStart(height + 1),
+          spans(included && width > 0 ? height : 0),
+          pixelCount(included && width > 0 ? (size_t)width * height : 0) {
+        for (int y = 0; y <= height; ++y) {
+            rowStart[y] = spans.getSize() ? y : 0;
+        }
+        for (int y = 0; y < spans.getSize(); ++y) {
+            spans[y] = {0, width};
+        }
+    }
+    // По байту на пиксель: ненулевой — пиксель включён
+    static RegionMask FromBitmask(const unsigned char *bits, int width,
+                                  int height) {
+        RegionMask result(width, height, false);
+        PATypes::DynamicArray<MaskSpan> all(0);
+        int count = 0;
+        for (int y = 0; y < height; ++y) {
+            result.rowStart[y] = count;
+            const unsigned char *row = bits + (size_t)y * width;
+            for (int x = 0; x < width;) {
+                if (!row[x]) {
+                    ++x;
+                    continue;
+                }
+                int from = x;
+                while (x < width && row[x])
+                    ++x;
+                all.resize(count + 1);
+                all[count++] = {from, x};
+                result.pixelCount += x - from;
+            }
+        }
+        result.rowStart[height] = count;
+        result.spans = std::move(all);
+        return result;
+    }
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    // число включённых пикселей
+    size_t GetPixelCount() const { return pixelCount; }
+    // доля включённых пикселей
+    double GetCoverage() const {
+        return width && height ? (double)pixelCount / ((size_t)width * height)
+                               : 0;
+    }
+    bool IsFull() const { return pixelCount == (size_t)width * height; }
+
+    int GetRowSpanCount(int y) const { return rowStart[y + 1] - rowStart[y]; }
+    const MaskSpan *GetRowSpans(int y) const {
+        return GetRowSpanCount(y) ? &spans[rowStart[y]] : nullptr;
+    }
+    bool IsIncluded(int x, int y) const {
+        const MaskSpan *row = GetRowSpans(y);
+        for (int i = 0; i < GetRowSpanCount(y); ++i) {
+            if (x >= row[i].from && x < row[i].to)
+                return true;
+        }
+        return false;
+    }
+
+    // Включает или исключает прямоугольник [x, x + w) x [y, y + h)
+    void Include(int x, int y, int w, int h) {
+        int from = std::clamp(x, 0, width), to = std::clamp(x + w, 0, width);
+        if (from >= to)
+            return;
+        RewriteRows(std::max(y, 0), std::min(y + h, height),
+                    [&](const MaskSpan *old, int count, MaskSpan *out) {
+                        int written = 0, i = 0;
+                        for (; i < count && old[i].to < from; ++i) {
+                            out[written++] = old[i];
+                        }
+                        MaskSpan merged = {from, to};
+                        for (; i < count && old[i].from <= to; ++i) {
+                            merged.from = std::min(merged.from, old[i].from);
+                            merged.to = std::max(merged.to, old[i].to);
+                        }
+                        out[written++] = merged;
+                        for (; i < count; ++i) {
+                            out[written++] = old[i];
+                        }
+                        return written;
+                    });
+    }
+    void Exclude(int x, int y, int w, int h) {
+        int from = std::clamp(x, 0, width), to = std::clamp(x + w, 0, width);
+        if (from >= to)
+            return;
+        RewriteRows(std::max(y, 0), std::min(y + h, height),
+                    [&](const MaskSpan *old, int count, MaskSpan *out) {
+                        int written = 0;
+                        for (int i = 0; i < count; ++i) {
+                            if (old[i].to <= from || old[i].from >= to) {
+                                out[written++] = old[i];
+                                continue;
+                            }
+                            if (old[i].from < from)
+                                out[written++] = {old[i].from, from};
+                            if (old[i].to > to)
+                                out[written++] = {to, old[i].to};
+                        }
+                        return written;
+                    });
+    }
+
+    // Маска для кадра, уменьшенного в factor раз (Frame::Downscale):
+    // пиксель включён, только если включён весь его квадрат factor x factor
+    RegionMask Downscale(int factor) const {
+        RegionMask result(width / factor, height / factor, false);
+        PATypes::DynamicArray<MaskSpan> all(0), common(1), next(1);
+        int count = 0;
+        for (int y = 0; y < result.height; ++y) {
+            result.rowStart[y] = count;
+            int commonCount = GetRowSpanCount(y * factor);
+            common.resize(commonCount + 1);
+            for (int i = 0; i < commonCount; ++i) {
+                common[i] = GetRowSpans(y * factor)[i];
+            }
+            for (int k = 1; k < factor && commonCount; ++k) {
+                int source = y * factor + k;
+                next.resize(commonCount + GetRowSpanCount(source) + 1);
+                commonCount = Intersect(&common[0], commonCount,
+                                        GetRowSpans(source),
+                                        GetRowSpanCount(source), &next[0]);
+                std::swap(common, next);
+            }
+            for (int i = 0; i < commonCount; ++i) {
+                int from = (common[i].from + factor - 1) / factor;
+                int to = std::min(common[i].to / factor, result.width);
+                if (from >= to)
+                    continue;
+                all.resize(count + 1);
+                all[count++] = {from, to};
+                result.pixelCount += to - from;
+            }
+        }
+        result.rowStart[result.height] = count;
+        result.spans = std::move(all);
+        return result;
+    }
+
+    // f(y, from, to) для каждого отрезка по порядку строк
+    template <class F> void ForEachSpan(F &&f) const {
+        for (int y = 0; y < height; ++y) {
+            const MaskSpan *row = GetRowSpans(y);
+            for (int i = 0; i < GetRowSpanCount(y); ++i) {
+                f(y, row[i].from, row[i].to);
+            }
+        }
+    }
+};
+} // namespace CCTV
@@ -1,8 +1,46 @@
 #pragma once
 
+#include <cmath>
+#include <memory>
+#include <optional>
+
+#include "Tags.hpp"
+
 namespace CCTV {
 	class IScoreable {
 	public:
 		virtual double GetScore(const std::optional<int>& r) = 0;
 	};
-};
\ No newline at end of file
+
+	// Метки по последовательности оценок кадров: вспышка (резкий рост
+	// средней яркости относительно предыдущего кадра) важнее скачка
+	// оценки, скачок — превышения порога. Яркость известна не во всех
+	// режимах оценки; NaN — вспышки не ищутся.
+	class ScoreTagger {
+		float treshold;
+		float leapTreshold;
+		float flashTreshold;
+		double prevScore;
+		double prevBrightness;
+
+	public:
+		ScoreTagger(float treshold, float leapTreshold, float flashTreshold = 40.0f)
+			: treshold(treshold), leapTreshold(leapTreshold), flashTreshold(flashTreshold), prevScore(0), prevBrightness(NAN) {}
+		std::shared_ptr<ITag> Feed(double score, void *parent, double brightness = NAN) {
+			std::shared_ptr<ITag> tag;
+			if (brightness - prevBrightness > flashTreshold)
+				tag = std::make_shared<FlashTag>(parent);
+			else if (std::fabs(score - prevScore) > leapTreshold)
+				tag = std::make_shared<ScoreLeapTag>(parent);
+			else if (score > treshold)
+				tag = std::make_shared<HighScoreTag>(parent);
+			prevScore = score;
+			prevBrightness = brightness;
+			return tag;
+		}
+		void Reset() {
+			prevScore = 0;
+			prevBrightness = NAN;
+		}
+	};
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include <PATypes/DynamicArray.h>
+
+namespace CCTV {
+// Оценки кадров по индексу: плотный массив значений и битовая карта
+// заполненности. Каждое 64-битное слово карты помечено эпохой, в которую
+// его последний раз писали; слово чужой эпохи считается пустым. Поэтому
+// Clear — это смена эпохи, O(1) при любом числе кадров, а слово обнуляется
+// лениво при первой записи в новой эпохе.
+class ScoreCache {
+    PATypes::DynamicArray<double> scores;
+    PATypes::DynamicArray<uint64_t> bits;
+    PATypes::DynamicArray<uint32_t> wordEpochs;
+    uint32_t epoch;
+
+    void Grow(int length) {
+        if (length <= scores.getSize())
+            return;
+        int words = (length + 63) / 64;
+        int previousWords = bits.getSize();
+        scores.resize(length);
+        if (words > previousWords) {
+            bits.resize(words);
+            wordEpochs.resize(words);
+            for (int i = previousWords; i < words; ++i) {
+                bits[i] = 0;
+                wordEpochs[i] = 0;
+            }
+        }
+    }
+
+  public:
+    // эпоха 0 зарезервирована за словами, в которые ещё не писали
+    ScoreCache() : scores(0), bits(0), wordEpochs(0), epoch(1) {}
+
+    bool Has(int r) {
+        if (r < 0 || r >= scores.getSize())
+            return false;
+        int word = r / 64;
+        return wordEpochs[word] == epoch && (bits[word] >> (r % 64) & 1);
+    }
+
+    std::optional<double> TryGet(int r) {
+        if (!Has(r))
+            return std::nullopt;
+        return scores[r];
+    }
+
+    void Set(int r, double score) {
+        if (r < 0)
+            return;
+        Grow(r + 1);
+        int word = r / 64;
+        if (wordEpochs[word] != epoch) {
+            wordEpochs[word] = epoch;
+            bits[word] = 0;
+        }
+        bits[word] |= (uint64_t)1 << (r % 64);
+        scores[r] = score;
+    }
+
+    void Clear() {
+        if (++epoch == 0) {
+            // эпохи кончились: один раз обнуляем метки всех слов
+            for (int i = 0; i < wordEpochs.getSize(); ++i) {
+                wordEpochs[i] = 0;
+            }
+            epoch = 1;
+        }
+    }
+};
+} // namespace CCTV
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#include <PATypes/DynamicArray.h>
+
+#include "ThreadPool.hpp"
+
+namespace CCTV {
+// Оценка кадра r по окну длины w — сумма дельт соседних кадров
+// (r, r - 1), ..., (r - w + 2, r - w + 1). Соседние окна отличаются одной
+// парой, поэтому дельта каждой пары считается ровно один раз и хранится
+// здесь, а сумма по окну ведётся скользящей. Смена длины окна не
+// инвалидирует дельты пар.
+class SlidingWindowScore {
+    // pairs[i] — дельта кадров i - 1 и i, NaN — ещё не посчитана
+    PATypes::DynamicArray<double> pairs;
+
+    static double Missing() { return std::numeric_limits<double>::quiet_NaN(); }
+
+    void Grow(int length) {
+        int previous = pairs.getSize();
+        if (length <= previous)
+            return;
+        pairs.resize(length);
+        for (int i = previous; i < length; ++i) {
+            pairs.set(i, Missing());
+        }
+    }
+
+  public:
+    SlidingWindowScore() : pairs(0) {}
+
+    int GetLength() { return pairs.getSize(); }
+
+    bool HasPair(int i) {
+        return i > 0 && i < pairs.getSize() && !std::isnan(pairs[i]);
+    }
+
+    void SetPair(int i, double value) {
+        Grow(i + 1);
+        pairs.set(i, value);
+    }
+
+    void Clear() { pairs = PATypes::DynamicArray<double>(0); }
+
+    template <class F> double GetPair(int i, F &&pairDelta) {
+        Grow(i + 1);
+        if (std::isnan(pairs[i]))
+            pairs.set(i, pairDelta(i));
+        return pairs[i];
+    }
+
+    // Оценка одного кадра: суммирует не более windowLength - 1 готовых
+    // дельт, досчитывая недостающие.
+    template <class F>
+    double GetScore(int r, int windowLength, F &&pairDelta) {
+        if (r < 0 || windowLength < 2)
+            return 0;
+        if (r - windowLength + 1 < 0)
+            throw std::out_of_range(
+                "окно оценки выходит за начало последовательности кадров");
+        double result = 0;
+        for (int i = 1; i < windowLength; ++i) {
+            result += GetPair(r - i + 1, pairDelta);
+        }
+        return result;
+    }
+
+    // Переносит дельты пар, которых здесь ещё нет, из other — например,
+    // посчитанные фоновой задачей на копии последовательности
+    void Merge(SlidingWindowScore &other) {
+        Grow(other.pairs.getSize());
+        for (int i = 1; i < other.pairs.getSize(); ++i) {
+            if (std::isnan(pairs[i]))
+                pairs.set(i, other.pairs[i]);
+        }
+    }
+
+    // Досчитывает дельты пар для кадров [from, to). Пары независимы,
+    // поэтому при наличии пула они считаются параллельно, каждая в свою
+    // ячейку — значения те же, что и при последовательном проходе. Когда
+    // cancelled() становится true, оставшиеся пары пропускаются и остаются
+    // не посчитанными.
+    template <class F, class C>
+    void PrecalcPairs(int from, int to, F &&pairDelta, ThreadPool *pool,
+                      C &&cancelled) {
+        from = std::max(from, 1);
+        Grow(to);
+        auto compute = [this, &pairDelta, &cancelled](int i) {
+            if (std::isnan(pairs[i]) && !cancelled())
+                pairs[i] = pairDelta(i);
+        };
+        if (pool) {
+            pool->ParallelFor(from, to, compute);
+        } else {
+            for (int i = from; i < to; ++i) {
+                compute(i);
+            }
+        }
+    }
+    template <class F>
+    void PrecalcPairs(int from, int to, F &&pairDelta,
+                      ThreadPool *pool = nullptr) {
+        PrecalcPairs(from, to, pairDelta, pool, [] { return false; });
+    }
+    template <class F>
+    void PrecalcPairs(int frames, F &&pairDelta, ThreadPool *pool = nullptr) {
+        PrecalcPairs(1, frames, pairDelta, pool);
+    }
+
+    // Оценки всех кадров [0, frames) по порядку: onScore(r, score)
+    // вызывается для каждого кадра, у которого окно целиком внутри
+    // последовательности. Дельты считаются блоками по BlockLength кадров;
+    // после каждого блока вызывается keepGoing(done) с числом обработанных
+    // кадров, false прерывает расчёт. cancelled() проверяется перед каждой
+    // дельтой пары, так что отмена не ждёт конца блока; оценки прерванного
+    // блока не выдаются. Возвращает, дошёл ли расчёт до конца.
+    static constexpr int BlockLength = 256;
+    template <class F, class G, class H, class C>
+    bool Precalc(int frames, int windowLength, F &&pairDelta, G &&onScore,
+                 ThreadPool *pool, H &&keepGoing, C &&cancelled) {
+        if (windowLength < 2) {
+            for (int r = 0; r < frames; ++r) {
+                onScore(r, 0.0);
+            }
+            return keepGoing(frames);
+        }
+        if (frames < windowLength)
+            return keepGoing(frames);
+        double sum = 0;
+        for (int from = 0; from < frames; from += BlockLength) {
+            int to = std::min(frames, from + BlockLength);
+            PrecalcPairs(from, to, pairDelta, pool, cancelled);
+            if (cancelled())
+                return false;
+            for (int r = from; r < to; ++r) {
+                if (r < windowLength - 1) {
+                    if (r > 0)
+                        sum += pairs[r];
+                    continue;
+                }
+                if (r == windowLength - 1)
+                    sum += pairs[r];
+                else
+                    sum += pairs[r] - pairs[r - windowLength + 1];
+                onScore(r, sum);
+            }
+            if (!keepGoing(to))
+                return false;
+        }
+        return true;
+    }
+    template <class F, class G>
+    void Precalc(int frames, int windowLength, F &&pairDelta, G &&onScore,
+                 ThreadPool *pool = nullptr) {
+        Precalc(frames, windowLength, pairDelta, onScore, pool,
+                [](int) { return true; }, [] { return false; });
+    }
+};
+} // namespace CCTV
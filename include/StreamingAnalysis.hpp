@@ -0,0 +1,194 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "Frame.hpp"
+#include "FramePipeline.hpp"
+
+namespace CCTV {
+// Анализ видео за один проход без загрузки всех кадров: каждый кадр
+// оценивается и размечается сразу после декодирования. Оценка та же, что у
+// FrameSequence::PrecalcScore (сумма дельт соседних кадров в окне), но в
+// памяти держатся только предыдущий кадр и последние windowLength - 1 дельт.
+// В режиме ScoreMode::LumaHistogram гистограмма кадра считается один раз и
+// уходит вместе с ним в previous. При analysisScale > 1 кадр сразу
+// уменьшается (Frame::Downscale) и полный больше не хранится, а
+// AnalyzeVideo получает от декодера уже уменьшенные кадры (sws_scale с
+// SWS_AREA): оценки от FrameSequence с тем же масштабом тогда немного
+// отличаются, фильтры у пирамиды и sws_scale разные. В режимах фона кадр
+// сравнивается с BackgroundModel, которая и так проходит кадры по порядку,
+// в режиме ScoreMode::Mixture — с MixtureModel, полосы строк которой
+// считаются на своём пуле потоков.
+class StreamingAnalysis {
+    int windowLength;
+    ScoreMode scoreMode;
+    HistogramMetric histogramMetric;
+    int analysisScale;
+    // маска в масштабе анализа, nullptr — весь кадр
+    std::shared_ptr<const RegionMask> mask;
+    ScoreTagger tagger;
+    BackgroundModel background;
+    MixtureModel mixture;
+    // потоки полос смеси гауссиан, 0 — по числу ядер
+    int mixtureThreads = 0;
+    std::shared_ptr<ThreadPool> pool;
+    PATypes::DynamicArray<double> recentPairs;
+    double windowSum;
+    Frame previous;
+    int frameCount;
+    int tagCount;
+
+  public:
+    // score вызывается для каждого кадра, у которого окно уже заполнено
+    std::function<void(int index, double score)> onScore;
+    std::function<void(int index, std::shared_ptr<ITag> tag)> onTag;
+
+    StreamingAnalysis(int windowLength, float treshold = 400.0f,
+                      float leapTreshold = 100.0f,
+                      ScoreMode scoreMode = ScoreMode::PixelDelta,
+                      HistogramMetric histogramMetric = HistogramMetric::ChiSquare,
+                      float flashTreshold = 40.0f, int analysisScale = 1)
+        : windowLength(windowLength), scoreMode(scoreMode),
+          histogramMetric(histogramMetric), analysisScale(analysisScale),
+          tagger(treshold, leapTreshold, flashTreshold),
+          background(scoreMode == ScoreMode::BackgroundMedian
+                         ? BackgroundKind::RunningMedian
+                         : BackgroundKind::RunningAverage,
+                     windowLength),
+          recentPairs(std::max(1, windowLength - 1)), windowSum(0), previous(),
+          frameCount(0), tagCount(0) {}
+
+    int GetWindow() const { return windowLength; }
+    ScoreMode GetScoreMode() const { return scoreMode; }
+    int GetAnalysisScale() const { return analysisScale; }
+    // Маска области интереса в пикселях полного кадра, как у
+    // FrameSequence::SetMask; задаётся до первого кадра
+    void SetMask(const std::shared_ptr<const RegionMask> &fullMask) {
+        if (!fullMask || fullMask->IsFull())
+            mask = nullptr;
+        else if (analysisScale > 1)
+            mask = std::make_shared<const RegionMask>(
+                fullMask->Downscale(analysisScale));
+        else
+            mask = fullMask;
+    }
+    // Параметры смеси гауссиан; задаются до первого кадра
+    // threads — потоки полос строк, как у FrameSequence::SetPrecalcThreads:
+    // 0 — по числу ядер, 1 — в потоке анализа
+    void SetMixtureParams(const MixtureParams &params, int threads = 0) {
+        mixture = MixtureModel(params);
+        mixtureThreads = std::max(0, threads);
+        pool = nullptr;
+    }
+    // Смесь после последнего кадра: её маска переднего плана
+    const MixtureModel &GetMixture() const { return mixture; }
+    int GetFrameCount() const { return frameCount; }
+    int GetTagCount() const { return tagCount; }
+
+    void Push(Frame frame) {
+        if (analysisScale > 1)
+            frame = frame.Downscale(analysisScale);
+        Analyze(std::move(frame));
+    }
+
+    // Декодирует файл и прогоняет через анализ все кадры; возвращает
+    // частоту кадров видео. Декодирование идёт в отдельном потоке и
+    // опережает анализ не больше чем на queueLength кадров.
+    // decodeThreads — потоки декодера, 0 — по числу ядер; кадры после
+    // анализа не показываются, так что DecodeFormat::Luma обычно выгоднее
+    float AnalyzeVideo(const std::string &filename, int decodeThreads = 0,
+                       int queueLength = 8,
+                       DecodeFormat format = DecodeFormat::RGB) {
+        DecodePipeline pipeline(filename, decodeThreads, queueLength, format,
+                                analysisScale);
+        while (std::optional<Frame> frame = pipeline.Read()) {
+            Analyze(std::move(*frame));
+        }
+        return pipeline.GetFramerate();
+    }
+
+  private:
+    ThreadPool *GetPool() {
+        int threads = mixtureThreads > 0 ? mixtureThreads
+                                         : ThreadPool::GetDefaultThreadCount();
+        if (threads == 1)
+            return nullptr;
+        if (!pool)
+            pool = std::make_shared<ThreadPool>(threads);
+        return pool.get();
+    }
+
+    // кадр уже в масштабе анализа
+    void Analyze(Frame frame) {
+        int r = frameCount++;
+        double brightness = NAN;
+        if (scoreMode == ScoreMode::LumaHistogram)
+            brightness = frame.GetCachedLumaHistogram(mask)->GetMean();
+        if (windowLength < 2) {
+            Emit(r, 0.0, brightness);
+            previous = std::move(frame);
+            return;
+        }
+        if (scoreMode == ScoreMode::Mixture) {
+            double score = mixture.Update(frame.GetData(), frame.GetWidth(),
+                                          frame.GetHeight(), frame.GetChannels(),
+                                          mask.get(), GetPool());
+            if (r >= windowLength - 1)
+                Emit(r, score, brightness);
+            return;
+        }
+        if (scoreMode == ScoreMode::BackgroundAverage ||
+            scoreMode == ScoreMode::BackgroundMedian) {
+            double score = background.Update(
+                frame.GetData(), frame.GetWidth(), frame.GetHeight(),
+                frame.GetChannels(), mask.get());
+            if (r >= windowLength - 1)
+                Emit(r, score, brightness);
+            return;
+        }
+        if (r > 0) {
+            // тот же порядок сложений, что и в SlidingWindowScore::Precalc,
+            // чтобы оценки совпадали с FrameSequence бит в бит
+            // recentPairs[r % (windowLength - 1)] хранит дельту пары
+            // r - windowLength + 1, выпадающей из окна на этом кадре
+            int slot = r % (windowLength - 1);
+            double pair;
+            if (scoreMode == ScoreMode::LumaHistogram)
+                pair = HistogramDistance(*frame.GetCachedLumaHistogram(mask),
+                                         *previous.GetCachedLumaHistogram(mask),
+                                         histogramMetric);
+            else if (scoreMode == ScoreMode::Tiles)
+                pair = frame.TileDelta(previous, TileGrid::DefaultTileSize,
+                                       mask.get())
+                           .GetMaxTileScore();
+            else if (mask)
+                pair = frame.MeanAbsDiff(previous, *mask);
+            else
+                pair = frame.MeanAbsDiff(previous);
+            if (r < windowLength) {
+                windowSum += pair;
+            } else {
+                windowSum += pair - recentPairs[slot];
+            }
+            recentPairs[slot] = pair;
+        }
+        if (r >= windowLength - 1)
+            Emit(r, windowSum, brightness);
+        previous = std::move(frame);
+    }
+
+    void Emit(int r, double score, double brightness) {
+        if (onScore)
+            onScore(r, score);
+        // кадр к моменту обработки метки уже не хранится
+        std::shared_ptr<ITag> tag = tagger.Feed(score, nullptr, brightness);
+        if (tag) {
+            ++tagCount;
+            if (onTag)
+                onTag(r, tag);
+        }
+    }
+};
+} // namespace CCTV
@@ -45,4 +45,14 @@ class FlashTag : public ITag {
     virtual void *GetParent() { return parent; }
     virtual std::string GetName() { return "Вспышка"; }
 };
+
+class ObjectTag : public ITag {
+    void *parent;
+
+  public:
+    ObjectTag(void *parent) : parent(parent) {}
+    virtual ~ObjectTag() {}
+    virtual void *GetParent() { return parent; }
+    virtual std::string GetName() { return "Объект"; }
+};
 }; // namespace CCTV
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstring>
+
+#include <GL/glew.h>
+
+#include "Frame.hpp"
+
+namespace CCTV {
+// Постоянная текстура окна просмотра. Хранит, какой кадр в ней лежит, и
+// перезаливает пиксели только при смене кадра, через glTexSubImage2D в ту же
+// текстуру. При воспроизведении пиксели идут через два PBO по очереди:
+// пока драйвер забирает один, следующий кадр пишется в другой.
+// Методы вызываются только в потоке с текущим GL-контекстом.
+class FrameTextureCache : public IGLTexture {
+    GLuint texture;
+    GLuint pixelBuffers[2];
+    int nextBuffer;
+    int width, height, channels;
+    // кадр в текстуре: индекс и буфер пикселей, -1 — ничего не загружено
+    int index;
+    const unsigned char *pixels;
+    int uploadCount;
+
+    static GLenum GetFormat(int channels) {
+        switch (channels) {
+        case 1:
+            return GL_RED;
+        case 4:
+            return GL_RGBA;
+        default:
+            return GL_RGB;
+        }
+    }
+
+    size_t GetDataSize() const { return (size_t)width * height * channels; }
+
+    void Allocate(const Frame &frame) {
+        width = frame.GetWidth();
+        height = frame.GetHeight();
+        channels = frame.GetChannels();
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GetFormat(channels), width, height, 0,
+                     GetFormat(channels), GL_UNSIGNED_BYTE, nullptr);
+        if (channels == 1) {
+            Frame::SetGrayscaleSwizzle();
+        } else {
+            GLint swizzle[4] = {GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA};
+            glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+        for (GLuint buffer : pixelBuffers) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, GetDataSize(), nullptr,
+                         GL_STREAM_DRAW);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    void UploadDirect(const Frame &frame) {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                        GetFormat(channels), GL_UNSIGNED_BYTE,
+                        frame.GetData());
+    }
+
+    // false — PBO не отобразился, пиксели надо залить напрямую
+    bool UploadStreaming(const Frame &frame) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffers[nextBuffer]);
+        void *mapped = glMapBufferRange(
+            GL_PIXEL_UNPACK_BUFFER, 0, GetDataSize(),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (!mapped) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return false;
+        }
+        memcpy(mapped, frame.GetData(), GetDataSize());
+        bool unmapped = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        if (unmapped)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height,
+                            GetFormat(channels), GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        nextBuffer ^= 1;
+        return unmapped;
+    }
+
+  public:
+    FrameTextureCache()
+        : nextBuffer(0), width(0), height(0), channels(0), index(-1),
+          pixels(nullptr), uploadCount(0) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glGenBuffers(2, pixelBuffers);
+    }
+    FrameTextureCache(const FrameTextureCache &) = delete;
+    FrameTextureCache &operator=(const FrameTextureCache &) = delete;
+    virtual ~FrameTextureCache() {
+        glDeleteBuffers(2, pixelBuffers);
+        glDeleteTextures(1, &texture);
+    }
+
+    virtual GLuint GetTexture() const { return texture; }
+    int GetIndex() const { return index; }
+    int GetUploadCount() const { return uploadCount; }
+
+    // Содержимое текстуры больше не соответствует индексам, например
+    // после открытия другого видео
+    void Invalidate() {
+        index = -1;
+        pixels = nullptr;
+    }
+
+    // Делает текстуру изображением кадра index. Если этот кадр уже загружен,
+    // ничего не делает. streaming — кадры сменяются каждый вызов
+    // (воспроизведение), пиксели лучше передавать через PBO.
+    void Show(const Frame &frame, int index, bool streaming = false) {
+        if (index == this->index && frame.GetData() == pixels)
+            return;
+        if (!frame.GetData()) {
+            Invalidate();
+            return;
+        }
+        if (frame.GetWidth() != width || frame.GetHeight() != height ||
+            frame.GetChannels() != channels)
+            Allocate(frame);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (!streaming || !UploadStreaming(frame))
+            UploadDirect(frame);
+        this->index = index;
+        pixels = frame.GetData();
+        ++uploadCount;
+    }
+};
+} // namespace CCTV
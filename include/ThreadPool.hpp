@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace CCTV {
+// Пул потоков с постоянными рабочими. ParallelFor делит диапазон на куски,
+// которые рабочие и вызывающий поток разбирают по общему счётчику, так что
+// неравномерные по стоимости куски балансируются сами.
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping;
+
+    void Work() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                available.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    }
+
+  public:
+    static int GetDefaultThreadCount() {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // threads — общее число потоков вместе с вызывающим, 0 — по числу ядер
+    ThreadPool(int threads = 0) : stopping(false) {
+        if (threads <= 0)
+            threads = GetDefaultThreadCount();
+        for (int i = 1; i < threads; ++i) {
+            workers.emplace_back([this] { Work(); });
+        }
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        available.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    int GetThreadCount() const { return workers.size() + 1; }
+
+    void Submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push(std::move(task));
+        }
+        available.notify_one();
+    }
+
+    // f(i) для всех i из [begin, end); возвращается, когда все вызовы
+    // завершены. Первое выброшенное исключение пробрасывается наружу.
+    template <class F> void ParallelFor(int begin, int end, F &&f) {
+        if (begin >= end)
+            return;
+        int threads = GetThreadCount();
+        int chunkCount = std::min(end - begin, threads * 8);
+        if (threads == 1 || chunkCount == 1) {
+            for (int i = begin; i < end; ++i) {
+                f(i);
+            }
+            return;
+        }
+
+        struct State {
+            std::atomic<int> nextChunk{0};
+            std::atomic<bool> failed{false};
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable done;
+            int running = 0;
+        };
+        auto state = std::make_shared<State>();
+        auto run = [state, begin, end, chunkCount, &f] {
+            int chunk;
+            while (!state->failed &&
+                   (chunk = state->nextChunk++) < chunkCount) {
+                long long length = end - begin;
+                int from = begin + (int)(length * chunk / chunkCount);
+                int to = begin + (int)(length * (chunk + 1) / chunkCount);
+                try {
+                    for (int i = from; i < to; ++i) {
+                        f(i);
+                    }
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (!state->error)
+                        state->error = std::current_exception();
+                    state->failed = true;
+                }
+            }
+        };
+
+        int helpers = std::min(threads - 1, chunkCount - 1);
+        state->running = helpers;
+        for (int i = 0; i < helpers; ++i) {
+            Submit([state, run] {
+                run();
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (--state->running == 0)
+                    state->done.notify_all();
+            });
+        }
+        run();
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&] { return state->running == 0; });
+        if (state->error)
+            std::rethrow_exception(state->error);
+    }
+};
+} // namespace CCTV
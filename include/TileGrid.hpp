@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+
+#include <PATypes/DynamicArray.h>
+
+#include "PixelKernels.hpp"
+#include "RegionMask.hpp"
+
+namespace CCTV {
+// Энергия разности двух кадров по плиткам tileSize x tileSize: сумма
+// модулей разностей байтов плитки. Одна средняя по кадру размывает
+// небольшой объект на статичной сцене, а здесь он остаётся заметен в своей
+// плитке. Сетка строится за один проход по строкам кадра SIMD-ядром
+// SumAbsDiff и занимает 4 байта на плитку (2040 плиток на 1080p при 32x32),
+// поэтому хранится при каждом кадре; оценки всего кадра и прямоугольной
+// области берутся уже из неё. Плитки последних столбца и строки могут быть
+// неполными. С маской RegionMask считаются только её отрезки, а площадью
+// плитки становится число включённых в неё пикселей.
+class TileGrid {
+    int width, height, channels, tileSize, columns, rows;
+    PATypes::DynamicArray<uint32_t> energy;
+    // включённых пикселей в плитке, если сетка по маске
+    bool masked;
+    PATypes::DynamicArray<uint32_t> areas;
+
+    void AddSpan(const unsigned char *a, const unsigned char *b, int y,
+                 int from, int to) {
+        uint32_t *row = &energy[(y / tileSize) * columns];
+        size_t offset = ((size_t)y * width) * channels;
+        for (int x = from; x < to;) {
+            int column = x / tileSize;
+            int end = std::min(to, (column + 1) * tileSize);
+            row[column] += (uint32_t)PixelKernels::SumAbsDiff(
+                a + offset + (size_t)x * channels,
+                b + offset + (size_t)x * channels,
+                (size_t)(end - x) * channels);
+            areas[(y / tileSize) * columns + column] += end - x;
+            x = end;
+        }
+    }
+
+  public:
+    static constexpr int DefaultTileSize = 32;
+
+    TileGrid()
+        : width(0), height(0), channels(0), tileSize(DefaultTileSize),
+          columns(0), rows(0), energy(1), masked(false), areas(0) {}
+    // mask — только эти пиксели, nullptr — все
+    TileGrid(const unsigned char *a, const unsigned char *b, int width,
+             int height, int channels, int tileSize = DefaultTileSize,
+             const RegionMask *mask = nullptr)
+        : width(width), height(height), channels(channels), tileSize(tileSize),
+          columns((width + tileSize - 1) / std::max(tileSize, 1)),
+          rows((height + tileSize - 1) / std::max(tileSize, 1)),
+          energy(std::max(1, columns * rows)),
+          masked(mask), areas(mask ? columns * rows : 0) {
+        // энергия плитки 32-битная
+        if (tileSize < 1 ||
+            (uint64_t)tileSize * tileSize * channels * 255 > UINT32_MAX)
+            throw std::invalid_argument("недопустимый размер плитки");
+        for (int i = 0; i < columns * rows; ++i) {
+            energy[i] = 0;
+        }
+        if (mask) {
+            if (mask->GetWidth() != width || mask->GetHeight() != height)
+                throw std::logic_error("маска не совпадает с кадром");
+            for (int i = 0; i < columns * rows; ++i) {
+                areas[i] = 0;
+            }
+            mask->ForEachSpan([&](int y, int from, int to) {
+                AddSpan(a, b, y, from, to);
+            });
+            return;
+        }
+        size_t stride = (size_t)width * channels;
+        size_t span = (size_t)tileSize * channels;
+        for (int y = 0; y < height; ++y) {
+            uint32_t *row = &energy[(y / tileSize) * columns];
+            const unsigned char *pa = a + y * stride, *pb = b + y * stride;
+            for (int column = 0; column < columns; ++column) {
+                size_t from = column * span;
+                row[column] += (uint32_t)PixelKernels::SumAbsDiff(
+                    pa + from, pb + from, std::min(span, stride - from));
+            }
+        }
+    }
+
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    int GetTileSize() const { return tileSize; }
+    int GetColumns() const { return columns; }
+    int GetRows() const { return rows; }
+
+    uint32_t GetEnergy(int column, int row) const {
+        return energy[row * columns + column];
+    }
+    // число пикселей плитки с учётом неполных на краях и маски
+    int GetTileArea(int column, int row) const {
+        if (masked)
+            return areas[row * columns + column];
+        return (std::min(width, (column + 1) * tileSize) - column * tileSize) *
+               (std::min(height, (row + 1) * tileSize) - row * tileSize);
+    }
+    // средний модуль разности на пиксель внутри плитки, как MeanAbsDiff
+    double GetTileScore(int column, int row) const {
+        int area = GetTileArea(column, row);
+        return area ? (double)GetEnergy(column, row) / area : 0;
+    }
+
+    // Оценка всего кадра (по маске — всех её пикселей); совпадает с
+    // Frame::MeanAbsDiff бит в бит
+    double GetFrameScore() const {
+        return GetRegionScore(0, 0, width, height);
+    }
+    // Оценка прямоугольника [x, x + w) x [y, y + h) в пикселях кадра: по
+    // всем плиткам, которые он задевает, поэтому граница области
+    // округляется наружу до границ плиток
+    double GetRegionScore(int x, int y, int w, int h) const {
+        int fromColumn = std::clamp(x / tileSize, 0, columns);
+        int fromRow = std::clamp(y / tileSize, 0, rows);
+        int toColumn = std::clamp((x + w + tileSize - 1) / tileSize, 0, columns);
+        int toRow = std::clamp((y + h + tileSize - 1) / tileSize, 0, rows);
+        uint64_t sum = 0, area = 0;
+        for (int row = fromRow; row < toRow; ++row) {
+            for (int column = fromColumn; column < toColumn; ++column) {
+                sum += GetEnergy(column, row);
+                area += GetTileArea(column, row);
+            }
+        }
+        return area ? (double)sum / area : 0;
+    }
+    // Оценка самой изменившейся плитки
+    double GetMaxTileScore() const {
+        double result = 0;
+        for (int row = 0; row < rows; ++row) {
+            for (int column = 0; column < columns; ++column) {
+                result = std::max(result, GetTileScore(column, row));
+            }
+        }
+        return result;
+    }
+};
+} // namespace CCTV
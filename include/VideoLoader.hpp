@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include "FramePipeline.hpp"
+#include "Frame.hpp"
+
+namespace CCTV {
+// Постепенная загрузка видео для UI: кадры декодируются в потоке
+// DecodePipeline, а Collect в каждом кадре интерфейса переносит готовые
+// в последовательность, не задерживая отрисовку дольше заданного времени.
+// Таймлайн растёт по мере декодирования, первый кадр виден сразу.
+class VideoLoader {
+    DecodePipeline pipeline;
+    int frameCount;
+    bool finished;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point stopped;
+
+  public:
+    // Кадров в очереди с запасом: между вызовами Collect проходит кадр
+    // интерфейса, и декодер за это время не должен упираться в очередь
+    static constexpr int QueueLength = 32;
+
+    VideoLoader(const std::string &filename, int decodeThreads = 0,
+                DecodeFormat format = DecodeFormat::RGB)
+        : pipeline(filename, decodeThreads, QueueLength, format), frameCount(0),
+          finished(false), started(std::chrono::steady_clock::now()),
+          stopped(started) {}
+
+    // Пустая последовательность с параметрами загружаемого видео
+    FrameSequence CreateSequence(int windowSize) {
+        FrameSequence result(windowSize);
+        result.SetDecodeThreads(pipeline.GetDecodeThreads());
+        if (pipeline.GetFramerate() > 0)
+            result.SetFramerate(pipeline.GetFramerate());
+        return result;
+    }
+
+    // Дописывает в frames готовые кадры, пока не кончится budget. Возвращает
+    // true, когда видео загружено целиком; ошибка декодирования
+    // пробрасывается здесь.
+    bool Collect(FrameSequence &frames, std::chrono::microseconds budget) {
+        if (finished)
+            return true;
+        auto deadline = std::chrono::steady_clock::now() + budget;
+        do {
+            std::optional<Frame> frame = pipeline.TryRead();
+            if (!frame) {
+                if (pipeline.IsFinished()) {
+                    finished = true;
+                    stopped = std::chrono::steady_clock::now();
+                }
+                break;
+            }
+            frames.append(std::move(*frame));
+            ++frameCount;
+        } while (std::chrono::steady_clock::now() < deadline);
+        return finished;
+    }
+
+    bool IsFinished() const { return finished; }
+    int GetFrameCount() const { return frameCount; }
+
+    // средняя скорость загрузки, кадров в секунду
+    float GetFramesPerSecond() const {
+        auto end = finished ? stopped : std::chrono::steady_clock::now();
+        float seconds = std::chrono::duration<float>(end - started).count();
+        return seconds > 0 ? frameCount / seconds : 0;
+    }
+
+    // доля декодированной длительности видео, -1 — длительность неизвестна
+    float GetProgress() const {
+        if (finished)
+            return 1.0f;
+        if (pipeline.GetDuration() <= 0)
+            return -1.0f;
+        return std::min(1.0f, (float)(pipeline.GetPosition() /
+                                      pipeline.GetDuration()));
+    }
+};
+} // namespace CCTV
@@ -1,6 +1,9 @@
+#include <cstring>
 #include <iostream>
+#include <vector>
 
 #include "Frame.hpp"
+#include "StreamingAnalysis.hpp"
 
 int main() {
 	CCTV::Frame frameStatic[] = {*CCTV::Frame::FromFile("../contrib/test/static/1.png"), *CCTV::Frame::FromFile("../contrib/test/static/2.png"), *CCTV::Frame::FromFile("../contrib/test/static/3.png"), *CCTV::Frame::FromFile("../contrib/test/static/4.png")};
@@ -25,5 +28,363 @@ int main() {
 		seqExplosion.append(*CCTV::Frame::FromFile("../contrib/test/explosion/" + res + ".png"));
 	}
 	std::cout << seqExplosion.GetScore() / 43 << std::endl;
+
+	using namespace CCTV::PixelKernels;
+	const CCTV::Frame &a = seqExplosion.Getrvalue(0), &b = seqExplosion.Getrvalue(1);
+	ForceSimdLevel(SimdLevel::Scalar);
+	double fused = a.MeanAbsDiff(b), delta = a.delta(b).norm(), masked = a.AND(b).XOR(b).norm();
+	CCTV::LumaHistogram luma = a.GetLumaHistogram();
+	uint32_t lumaTotal = 0;
+	for (int bin = 0; bin < CCTV::LumaHistogram::Bins; ++bin) {
+		lumaTotal += luma.bins[bin];
+	}
+	if (lumaTotal != (uint32_t)(a.GetWidth() * a.GetHeight())) {
+		std::cerr << "гистограмма яркости потеряла пиксели" << std::endl;
+		return 1;
+	}
+	for (SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512BW}) {
+		if (!IsSimdLevelSupported(level))
+			continue;
+		ForceSimdLevel(level);
+		CCTV::LumaHistogram levelLuma = a.GetLumaHistogram();
+		if (a.MeanAbsDiff(b) != fused || a.delta(b).norm() != delta || a.AND(b).XOR(b).norm() != masked ||
+			memcmp(levelLuma.bins, luma.bins, sizeof(luma.bins)) != 0) {
+			std::cerr << "ядра " << GetSimdLevelName(level) << " расходятся со скалярными" << std::endl;
+			return 1;
+		}
+	}
+
+	CCTV::FrameSequence seqParallel(seqExplosion);
+	seqExplosion.SetWindow(5);
+	seqExplosion.SetPrecalcThreads(1);
+	seqExplosion.PrecalcScore();
+	seqParallel.SetWindow(5);
+	seqParallel.SetPrecalcThreads(4);
+	seqParallel.PrecalcScore();
+	if (seqExplosion.GetTagCount() != seqParallel.GetTagCount()) {
+		std::cerr << "параллельный PrecalcScore дал другое число меток" << std::endl;
+		return 1;
+	}
+	auto serialTags = seqExplosion.GetTagEnumerator(), parallelTags = seqParallel.GetTagEnumerator();
+	while (serialTags->moveNext() && parallelTags->moveNext()) {
+		if (serialTags->current().getFirst() != parallelTags->current().getFirst() ||
+			serialTags->current().getSecond()->GetName() != parallelTags->current().getSecond()->GetName()) {
+			std::cerr << "параллельный PrecalcScore дал другие метки" << std::endl;
+			return 1;
+		}
+	}
+	delete serialTags;
+	delete parallelTags;
+	if (seqExplosion.TryGetScore(0) || seqExplosion.TryGetScore(3) || seqExplosion.TryGetScore(4) != seqExplosion.GetScore(4)) {
+		std::cerr << "TryGetScore неверен у начала последовательности" << std::endl;
+		return 1;
+	}
+
+	for (CCTV::HistogramMetric metric : {CCTV::HistogramMetric::ChiSquare, CCTV::HistogramMetric::Bhattacharyya, CCTV::HistogramMetric::EarthMovers}) {
+		double self = CCTV::HistogramDistance(luma, luma, metric);
+		seqExplosion.SetScoreMode(CCTV::ScoreMode::LumaHistogram, metric);
+		seqParallel.SetScoreMode(CCTV::ScoreMode::LumaHistogram, metric);
+		seqExplosion.PrecalcScore();
+		seqParallel.PrecalcScore();
+		if (self > 1e-6 || seqExplosion.GetScore(20) != seqParallel.GetScore(20) || seqExplosion.GetTagCount() != seqParallel.GetTagCount()) {
+			std::cerr << "оценка по гистограммам (" << CCTV::GetHistogramMetricName(metric) << ") неверна" << std::endl;
+			return 1;
+		}
+	}
+
+	unsigned char plane[4 * 3];
+	for (int i = 0; i < 12; ++i) {
+		plane[i] = i;
+	}
+	CCTV::Frame planeFrame = CCTV::Frame::FromPlane(plane, 4, 3, 3);
+	if (planeFrame.GetChannels() != 1 || planeFrame.GetData()[2] != 2 || planeFrame.GetData()[3] != 4 || planeFrame.GetData()[8] != 10) {
+		std::cerr << "кадр из плоскости Y с шагом строки собран неверно" << std::endl;
+		return 1;
+	}
+	bool rgbOnly = false;
+	try {
+		planeFrame.GetPoint({1, 1});
+	} catch (const std::logic_error &) {
+		rgbOnly = true;
+	}
+	if (!rgbOnly) {
+		std::cerr << "поточечная операция RGB приняла кадр яркости" << std::endl;
+		return 1;
+	}
+
+	const unsigned char square[] = {0, 2, 10, 20, 7, 4, 1, 3, 9, 9, 4, 6, 30, 50, 255, 255, 9, 9};
+	CCTV::Frame halved = CCTV::Frame(6, 3, 1, square).Halve();
+	if (halved.GetWidth() != 3 || halved.GetHeight() != 1 || halved.GetData()[0] != 2 || halved.GetData()[1] != 13 || halved.GetData()[2] != 6) {
+		std::cerr << "уровень пирамиды посчитан неверно" << std::endl;
+		return 1;
+	}
+	std::vector<unsigned char> gray(203 * 117);
+	for (size_t i = 0; i < gray.size(); ++i) {
+		gray[i] = (unsigned char)(i * 31 + (i >> 7));
+	}
+	CCTV::Frame grayFrame(203, 117, 1, gray.data());
+	ForceSimdLevel(SimdLevel::Scalar);
+	CCTV::Frame scalarGray = grayFrame.Downscale(4), scalarRGB = a.Downscale(8);
+	ForceSimdLevel(DetectSimdLevel());
+	CCTV::Frame simdGray = grayFrame.Downscale(4), simdRGB = a.Downscale(8);
+	if (scalarGray.GetWidth() != 50 || scalarGray.GetHeight() != 29 || memcmp(scalarGray.GetData(), simdGray.GetData(), 50 * 29) || memcmp(scalarRGB.GetData(), simdRGB.GetData(), scalarRGB.GetWidth() * scalarRGB.GetHeight() * 3)) {
+		std::cerr << "пирамида scalar и " << GetSimdLevelName(GetSimdLevel()) << " расходятся" << std::endl;
+		return 1;
+	}
+
+	seqExplosion.SetScoreMode(CCTV::ScoreMode::PixelDelta);
+	CCTV::FrameSequence seqScaled(seqExplosion);
+	seqScaled.SetAnalysisScale(4);
+	if (a.GetDownscaled(4) != a.GetDownscaled(4) || a.GetDownscaled(4)->GetWidth() != a.GetWidth() / 4) {
+		std::cerr << "уменьшенная копия кадра не сохраняется" << std::endl;
+		return 1;
+	}
+	double fullScore = seqExplosion.GetScore(30), scaledScore = seqScaled.GetScore(30);
+	if (!(scaledScore > 0.5 * fullScore && scaledScore < 1.05 * fullScore)) {
+		std::cerr << "оценка при масштабе 1/4 далека от полной: " << scaledScore << " и " << fullScore << std::endl;
+		return 1;
+	}
+
+	CCTV::TileGrid tiles = a.TileDelta(b);
+	if (tiles.GetFrameScore() != a.MeanAbsDiff(b) || tiles.GetColumns() != (a.GetWidth() + 31) / 32) {
+		std::cerr << "оценка кадра по плиткам не совпала с MeanAbsDiff" << std::endl;
+		return 1;
+	}
+	std::vector<unsigned char> scene(250 * 150 * 3, 90), intruder = scene;
+	for (int y = 100; y < 116; ++y) {
+		for (int x = 200; x < 216; ++x) {
+			intruder[(y * 250 + x) * 3] = 250;
+		}
+	}
+	CCTV::Frame still[] = {CCTV::Frame(250, 150, 3, scene.data()), CCTV::Frame(250, 150, 3, intruder.data())};
+	CCTV::TileGrid intruderTiles = still[1].TileDelta(still[0]);
+	if (intruderTiles.GetMaxTileScore() != 16 * 16 * 160 / (32.0 * 32) || intruderTiles.GetRegionScore(0, 0, 190, 150) != 0 ||
+		intruderTiles.GetRegionScore(210, 110, 1, 1) != intruderTiles.GetMaxTileScore()) {
+		std::cerr << "плитки не выделили изменившуюся область" << std::endl;
+		return 1;
+	}
+	CCTV::FrameSequence seqTiles(still, 2, 2);
+	seqTiles.SetScoreMode(CCTV::ScoreMode::Tiles);
+	seqTiles.SetAnalysisScale(2);
+	if (seqTiles.GetScore(1) < 10 * still[1].MeanAbsDiff(still[0]) || seqTiles.GetTileGrid(1)->GetWidth() != 125 || seqTiles.GetRegionScore(1, 0, 0, 190, 150) != 0) {
+		std::cerr << "оценка по плиткам в последовательности неверна" << std::endl;
+		return 1;
+	}
+
+	CCTV::RegionMask mask(250, 150);
+	mask.Exclude(180, 80, 50, 50);
+	mask.Exclude(0, 0, 40, 150);
+	mask.Include(20, 10, 30, 5);
+	std::vector<unsigned char> bits(250 * 150);
+	for (int y = 0; y < 150; ++y) {
+		for (int x = 0; x < 250; ++x) {
+			bool excluded = (x >= 180 && x < 230 && y >= 80 && y < 130) || (x < 40 && !(x >= 20 && y >= 10 && y < 15));
+			bits[y * 250 + x] = !excluded;
+		}
+	}
+	CCTV::RegionMask fromBits = CCTV::RegionMask::FromBitmask(bits.data(), 250, 150);
+	bool sameMask = mask.GetPixelCount() == fromBits.GetPixelCount() && mask.GetRowSpanCount(12) == 1 && mask.GetRowSpanCount(100) == 2;
+	for (int y = 0; sameMask && y < 150; ++y) {
+		for (int x = 0; x < 250; ++x) {
+			sameMask = sameMask && mask.IsIncluded(x, y) == (bool)bits[y * 250 + x] && fromBits.IsIncluded(x, y) == (bool)bits[y * 250 + x];
+		}
+	}
+	CCTV::RegionMask halfMask = mask.Downscale(2);
+	for (int y = 0; sameMask && y < 75; ++y) {
+		for (int x = 0; x < 125; ++x) {
+			bool whole = bits[2 * y * 250 + 2 * x] && bits[2 * y * 250 + 2 * x + 1] && bits[(2 * y + 1) * 250 + 2 * x] && bits[(2 * y + 1) * 250 + 2 * x + 1];
+			sameMask = sameMask && halfMask.IsIncluded(x, y) == whole;
+		}
+	}
+	if (!sameMask) {
+		std::cerr << "маска области интереса собрана неверно" << std::endl;
+		return 1;
+	}
+	uint64_t maskedSum = 0;
+	for (int y = 0; y < 150; ++y) {
+		for (int x = 0; x < 250; ++x) {
+			for (int c = 0; bits[y * 250 + x] && c < 3; ++c) {
+				maskedSum += std::abs(intruder[(y * 250 + x) * 3 + c] - scene[(y * 250 + x) * 3 + c]);
+			}
+		}
+	}
+	CCTV::LumaHistogram maskedLuma = still[1].GetLumaHistogram(mask);
+	if (still[1].MeanAbsDiff(still[0], mask) != (double)maskedSum / mask.GetPixelCount() || maskedLuma.total != mask.GetPixelCount() ||
+		still[1].TileDelta(still[0], 32, &mask).GetFrameScore() != still[1].MeanAbsDiff(still[0], mask)) {
+		std::cerr << "оценка по маске не совпала с прямым подсчётом" << std::endl;
+		return 1;
+	}
+	// маска закрывает изменившуюся область — меток нет
+	CCTV::FrameSequence seqMasked(still, 2, 2, 1.0f, 1.0f);
+	seqMasked.PrecalcScore();
+	int unmaskedTags = seqMasked.GetTagCount();
+	seqMasked.SetMask(std::make_shared<const CCTV::RegionMask>(mask));
+	seqMasked.SetAnalysisScale(2);
+	seqMasked.PrecalcScore();
+	if (unmaskedTags != 1 || seqMasked.GetTagCount() != 0 || seqMasked.GetScore(1) != 0) {
+		std::cerr << "исключённая маской область повлияла на оценку" << std::endl;
+		return 1;
+	}
+
+	for (CCTV::BackgroundKind kind : {CCTV::BackgroundKind::RunningAverage, CCTV::BackgroundKind::RunningMedian}) {
+		std::vector<double> scalarScores;
+		std::vector<unsigned char> scalarBackground(a.GetWidth() * a.GetHeight() * 3);
+		for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512BW}) {
+			if (!IsSimdLevelSupported(level))
+				continue;
+			ForceSimdLevel(level);
+			CCTV::BackgroundModel model(kind, 4);
+			std::vector<double> scores;
+			for (int i = 0; i < 8; ++i) {
+				const CCTV::Frame &frame = seqExplosion.Getrvalue(i);
+				scores.push_back(model.Update(frame.GetData(), frame.GetWidth(), frame.GetHeight(), 3));
+			}
+			std::vector<unsigned char> background(scalarBackground.size());
+			model.GetBackground(background.data());
+			if (level == SimdLevel::Scalar) {
+				scalarScores = scores;
+				scalarBackground = background;
+			} else if (scores != scalarScores || background != scalarBackground) {
+				std::cerr << "модель фона " << GetSimdLevelName(level) << " расходится со скалярной" << std::endl;
+				return 1;
+			}
+		}
+	}
+	ForceSimdLevel(DetectSimdLevel());
+	// объект появляется на кадре 6 и остаётся: фон его постепенно вбирает
+	std::vector<CCTV::Frame> arrival;
+	for (int i = 0; i < 12; ++i) {
+		arrival.push_back(still[i < 6 ? 0 : 1]);
+	}
+	for (CCTV::ScoreMode mode : {CCTV::ScoreMode::BackgroundAverage, CCTV::ScoreMode::BackgroundMedian}) {
+		CCTV::FrameSequence seqBackground(arrival.data(), 12, 4);
+		seqBackground.SetScoreMode(mode);
+		CCTV::FrameSequence seqPrecalc(seqBackground);
+		seqPrecalc.PrecalcScore();
+		bool same = !seqBackground.TryGetScore(11) && seqPrecalc.TryGetScore(11) == seqPrecalc.GetScore(11) && !seqPrecalc.TryGetScore(2);
+		for (int r = 11; r >= 3; --r) {
+			same = same && seqBackground.GetScore(r) == seqPrecalc.GetScore(r);
+		}
+		if (!same || seqBackground.GetScore(5) != 0 || seqBackground.GetScore(6) != still[1].MeanAbsDiff(still[0]) ||
+			!(seqBackground.GetScore(11) < seqBackground.GetScore(6))) {
+			std::cerr << "оценка по фону (" << CCTV::GetScoreModeName(mode) << ") неверна" << std::endl;
+			return 1;
+		}
+	}
+	// отмена прерывает расчёт на ближайшем кадре, не дожидаясь конца блока
+	for (CCTV::ScoreMode mode : {CCTV::ScoreMode::PixelDelta, CCTV::ScoreMode::BackgroundAverage}) {
+		CCTV::FrameSequence seqCancel(arrival.data(), 12, 4);
+		seqCancel.SetScoreMode(mode);
+		int scored = 0, checks = 0;
+		bool complete = seqCancel.PrecalcScores([&scored](int, double) { ++scored; }, [](int) { return true; }, [&checks] { return ++checks > 5; });
+		if (complete || scored > 5) {
+			std::cerr << "отмена расчёта (" << CCTV::GetScoreModeName(mode) << ") ждёт конца блока: " << scored << " оценок" << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<double> scalarMixture;
+	std::vector<unsigned char> scalarForeground;
+	for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::AVX2, SimdLevel::AVX512BW}) {
+		if (!IsSimdLevelSupported(level))
+			continue;
+		ForceSimdLevel(level);
+		for (int threads : {1, 4}) {
+			CCTV::ThreadPool pool(threads);
+			CCTV::MixtureModel model;
+			std::vector<double> scores;
+			for (int i = 0; i < 8; ++i) {
+				const CCTV::Frame &frame = seqExplosion.Getrvalue(i);
+				scores.push_back(model.Update(frame.GetData(), frame.GetWidth(), frame.GetHeight(), 3, nullptr, &pool));
+			}
+			std::vector<unsigned char> foreground(model.GetForeground(), model.GetForeground() + a.GetWidth() * a.GetHeight());
+			if (scalarMixture.empty()) {
+				scalarMixture = scores;
+				scalarForeground = foreground;
+			} else if (scores != scalarMixture || foreground != scalarForeground) {
+				std::cerr << "смесь гауссиан " << GetSimdLevelName(level) << " в " << threads << " потоков расходится со скалярной" << std::endl;
+				return 1;
+			}
+		}
+	}
+	ForceSimdLevel(DetectSimdLevel());
+	// левая полоса мерцает, как листва на ветру, на кадре 38 появляется объект
+	std::vector<unsigned char> swaying = scene;
+	for (int y = 0; y < 150; ++y) {
+		for (int x = 0; x < 100; ++x) {
+			for (int c = 0; c < 3; ++c) {
+				swaying[(y * 250 + x) * 3 + c] = 180;
+			}
+		}
+	}
+	std::vector<unsigned char> swayingIntruder = swaying;
+	for (int y = 100; y < 116; ++y) {
+		for (int x = 200; x < 216; ++x) {
+			swayingIntruder[(y * 250 + x) * 3] = 250;
+		}
+	}
+	std::vector<CCTV::Frame> foliage;
+	for (int i = 0; i < 40; ++i) {
+		const std::vector<unsigned char> &pixels = i % 2 ? (i < 38 ? swaying : swayingIntruder) : (i < 38 ? scene : intruder);
+		foliage.push_back(CCTV::Frame(250, 150, 3, pixels.data()));
+	}
+	CCTV::FrameSequence seqFoliage(foliage.data(), 40, 2), seqFoliageDelta(foliage.data(), 40, 2);
+	CCTV::MixtureParams foliageParams;
+	foliageParams.learningRate = 0.05f;
+	seqFoliage.SetMixtureParams(foliageParams);
+	seqFoliage.SetScoreMode(CCTV::ScoreMode::Mixture);
+	if (seqFoliage.TryGetScore(37) || seqFoliage.GetScore(37) != 0 || seqFoliage.GetScore(38) != 256.0 / (250 * 150) * 255 || seqFoliage.GetMixture().GetForeground()[100 * 250 + 200] != 255 ||
+		!(seqFoliageDelta.GetScore(37) > 20)) {
+		std::cerr << "смесь гауссиан не отделила мерцание от объекта: " << seqFoliage.GetScore(37) << " " << seqFoliage.GetScore(38) << std::endl;
+		return 1;
+	}
+
+	// потоковый анализ даёт те же оценки и метки, что и PrecalcScore
+	std::vector<CCTV::Frame> streamed;
+	for (int i = 0; i < 16; ++i) {
+		const CCTV::Frame &frame = seqExplosion.Getrvalue(i);
+		streamed.push_back(CCTV::Frame(frame.GetWidth(), frame.GetHeight(), 3, frame.GetData()));
+	}
+	for (CCTV::ScoreMode mode : {CCTV::ScoreMode::PixelDelta, CCTV::ScoreMode::LumaHistogram, CCTV::ScoreMode::Tiles, CCTV::ScoreMode::BackgroundAverage,
+								 CCTV::ScoreMode::BackgroundMedian, CCTV::ScoreMode::Mixture}) {
+		for (int window : {1, 2, 5}) {
+			CCTV::FrameSequence seqStream(streamed.data(), 16, window);
+			seqStream.SetScoreMode(mode);
+			seqStream.SetTreshold(20);
+			seqStream.SetLeapTreshold(5);
+			seqStream.PrecalcScore();
+			CCTV::StreamingAnalysis analysis(window, 20, 5, mode, seqStream.GetHistogramMetric(), seqStream.GetFlashTreshold());
+			analysis.SetMixtureParams(seqStream.GetMixtureParams(), 1);
+			std::vector<int> scored, tagged;
+			bool same = true;
+			analysis.onScore = [&](int r, double score) {
+				scored.push_back(r);
+				same = same && seqStream.HasScore(r) && score == seqStream.GetScore(r);
+			};
+			analysis.onTag = [&](int r, std::shared_ptr<CCTV::ITag> tag) {
+				tagged.push_back(r);
+				same = same && seqStream.Getrvalue(r).GetTag() && seqStream.Getrvalue(r).GetTag()->GetName() == tag->GetName();
+			};
+			for (const CCTV::Frame &frame : streamed) {
+				analysis.Push(frame);
+			}
+			if (!same || (int)scored.size() != 16 - std::max(window - 1, 0) || (int)tagged.size() != seqStream.GetTagCount() ||
+				analysis.GetTagCount() != seqStream.GetTagCount()) {
+				std::cerr << "потоковый анализ (" << CCTV::GetScoreModeName(mode) << ", окно " << window << ") расходится с PrecalcScore" << std::endl;
+				return 1;
+			}
+		}
+	}
+
+	CCTV::Frame copy = a;
+	if (!copy.SharesData(a) || !seqParallel.Getrvalue(0).SharesData(a)) {
+		std::cerr << "копия кадра не делит пиксели с исходным" << std::endl;
+		return 1;
+	}
+	copy.GetMutableData()[0] ^= 0xff;
+	if (copy.SharesData(a) || copy.GetData()[0] == a.GetData()[0]) {
+		std::cerr << "запись в копию кадра изменила исходный" << std::endl;
+		return 1;
+	}
 	return 0;
 }
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include "Classifier.hpp"
+#include "Frame.hpp"
+
+using namespace CCTV::PixelKernels;
+
+template <class F> static double Measure(int iterations, F &&f) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		f();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+int main(int argc, char **argv) {
+	const int width = 1920, height = 1080, iterations = 5;
+	std::vector<unsigned char> pixels(width * height * 3);
+	for (size_t i = 0; i < pixels.size(); ++i) {
+		pixels[i] = (unsigned char)(i * 31 + (i >> 7) + (i / (width * 3 * 16)) * 5);
+	}
+	CCTV::IntegralImage image = CCTV::Frame(width, height, 3, pixels.data()).GetIntegralImage();
+	// каскад в духе лицевых: первая стадия отсеивает почти всё, дальше
+	// стадии длиннее
+	std::istringstream description(
+		"24 24 3\n"
+		"2 1\n"
+		"2  0 0 24 24 1  6 6 12 12 -4  0.8 0 1\n"
+		"3  0 0 8 24 1  8 0 8 24 -2  16 0 8 24 1  0.2 0 1\n"
+		"3 1.5\n"
+		"2  0 0 12 24 1  12 0 12 24 -1  0.15 1 0\n"
+		"2  0 0 12 24 1  12 0 12 24 -1  -0.15 0 1\n"
+		"2  0 0 24 12 1  0 12 24 12 -1  0.3 1 0\n"
+		"4 2\n"
+		"2  0 0 24 24 1  4 4 16 16 -2.25  0.5 0 1\n"
+		"2  0 0 24 8 1  0 8 24 8 -1  0.1 1 0\n"
+		"3  0 0 24 8 1  0 8 24 8 -2  0 16 24 8 1  0 0 1\n"
+		"2  0 0 6 24 1  18 0 6 24 -1  0.2 1 0\n");
+	CCTV::HaarCascade cascade = CCTV::HaarCascade::FromStream(description);
+	long long windows = cascade.CountWindows(width, height);
+
+	std::vector<SimdLevel> levels;
+	if (argc > 1) {
+		levels.push_back(ParseSimdLevel(argv[1]));
+	} else {
+		levels = {SimdLevel::Scalar, SimdLevel::AVX2};
+	}
+	std::vector<int> threads = {1, 2, 4};
+	if (CCTV::ThreadPool::GetDefaultThreadCount() > 4)
+		threads.push_back(CCTV::ThreadPool::GetDefaultThreadCount());
+
+	std::cout << "Кадр " << width << "x" << height << ", " << windows << " окон, миллионов окон в секунду" << std::endl;
+	std::cout << "уровень\\потоки";
+	for (int count : threads) {
+		std::cout << "\t" << count;
+	}
+	std::cout << std::endl;
+	double sink = 0;
+	for (SimdLevel level : levels) {
+		if (!IsSimdLevelSupported(level)) {
+			std::cout << GetSimdLevelName(level) << "\tне поддерживается" << std::endl;
+			continue;
+		}
+		ForceSimdLevel(level);
+		std::cout << GetSimdLevelName(level);
+		for (int count : threads) {
+			CCTV::ThreadPool pool(count);
+			double ms = Measure(iterations, [&] { sink += cascade.Detect(image, CCTV::HaarDetectParams(), count > 1 ? &pool : nullptr).getLength(); });
+			std::cout << "\t" << windows / ms / 1000;
+		}
+		std::cout << std::endl;
+	}
+	return sink < 0;
+}
@@ -1,6 +1,152 @@
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <vector>
 
-//#include "Classifier.hpp"
+#include "Classifier.hpp"
+#include "Frame.hpp"
+
+// Светлый фон с шумом, на нём тёмные квадраты в светлой рамке
+static std::vector<unsigned char> MakeScene(int width, int height, const std::vector<CCTV::Detection> &objects) {
+	std::vector<unsigned char> pixels(width * height * 3);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			unsigned char value = 180 + (x * 7 + y * 13) % 16;
+			for (const CCTV::Detection &object : objects) {
+				int border = object.width / 4;
+				if (x >= object.x + border && x < object.x + object.width - border && y >= object.y + border && y < object.y + object.height - border)
+					value = 40 + (x * 3 + y * 5) % 8;
+			}
+			for (int c = 0; c < 3; ++c) {
+				pixels[(y * width + x) * 3 + c] = value;
+			}
+		}
+	}
+	return pixels;
+}
+
+static bool Covers(const CCTV::Detection &found, const CCTV::Detection &object) {
+	int cx = found.x + found.width / 2, cy = found.y + found.height / 2;
+	int ox = object.x + object.width / 2, oy = object.y + object.height / 2;
+	return std::abs(cx - ox) <= object.width / 4 && std::abs(cy - oy) <= object.height / 4;
+}
+
+template <class F> static double Measure(int iterations, F &&f) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		f();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
 
 int main() {
+	using namespace CCTV::PixelKernels;
+	const int width = 203, height = 117;
+	std::vector<unsigned char> noise(width * height * 3);
+	for (size_t i = 0; i < noise.size(); ++i) {
+		noise[i] = (unsigned char)(i * 31 + (i >> 7));
+	}
+	CCTV::Frame noisy(width, height, 3, noise.data());
+	ForceSimdLevel(SimdLevel::Scalar);
+	CCTV::IntegralImage scalar = noisy.GetIntegralImage();
+	ForceSimdLevel(DetectSimdLevel());
+	CCTV::IntegralImage vectorized = noisy.GetIntegralImage();
+	for (int y = 0; y <= height; ++y) {
+		for (int x = 0; x <= width; ++x) {
+			if (scalar.Sum(x, y) != vectorized.Sum(x, y) || scalar.SumSq(x, y) != vectorized.SumSq(x, y)) {
+				std::cerr << "интегральные изображения scalar и " << GetSimdLevelName(GetSimdLevel()) << " расходятся в (" << x << ", " << y << ")" << std::endl;
+				return 1;
+			}
+		}
+	}
+	const int rects[][4] = {{0, 0, width, height}, {5, 7, 1, 1}, {17, 3, 40, 90}, {width - 9, height - 4, 9, 4}};
+	for (const int *rect : rects) {
+		uint64_t sum = 0, sumSq = 0;
+		for (int y = rect[1]; y < rect[1] + rect[3]; ++y) {
+			for (int x = rect[0]; x < rect[0] + rect[2]; ++x) {
+				const unsigned char *p = noise.data() + (y * width + x) * 3;
+				unsigned luma = CCTV::HistogramKernels::Luma(p[0], p[1], p[2]);
+				sum += luma;
+				sumSq += luma * luma;
+			}
+		}
+		if (vectorized.RectSum(rect[0], rect[1], rect[2], rect[3]) != sum || vectorized.RectSumSq(rect[0], rect[1], rect[2], rect[3]) != sumSq) {
+			std::cerr << "сумма по прямоугольнику не совпала с прямым подсчётом" << std::endl;
+			return 1;
+		}
+	}
+
+	// Две стадии: центр темнее окна, окно симметрично слева направо
+	std::istringstream description(
+		"24 24 2\n"
+		"1 0.5\n"
+		"2  0 0 24 24 1  6 6 12 12 -4  0.8 0 1\n"
+		"2 1.5\n"
+		"2  0 0 12 24 1  12 0 12 24 -1  0.15 1 0\n"
+		"2  0 0 12 24 1  12 0 12 24 -1  -0.15 0 1\n");
+	CCTV::HaarCascade cascade = CCTV::HaarCascade::FromStream(description);
+	CCTV::HaarFeature centre = {{{0, 0, 24, 24, 1}, {6, 6, 12, 12, -4}}, 2};
+	std::vector<CCTV::Detection> objects = {{40, 30, 24, 24}, {150, 60, 48, 48}};
+	std::vector<unsigned char> scene = MakeScene(240, 135, objects);
+	CCTV::Frame frame(240, 135, 3, scene.data());
+	CCTV::IntegralImage image = frame.GetIntegralImage();
+	if (centre.Evaluate(image, 40, 30) <= 0 || std::abs(centre.Evaluate(image, 0, 0)) > 24 * 24 * 16) {
+		std::cerr << "признак Хаара посчитан неверно" << std::endl;
+		return 1;
+	}
+	PATypes::MutableArraySequence<CCTV::Detection> found = cascade.Detect(image);
+	for (const CCTV::Detection &object : objects) {
+		bool detected = false;
+		for (int i = 0; i < found.getLength(); ++i) {
+			detected = detected || Covers(found.Getrvalue(i), object);
+		}
+		if (!detected) {
+			std::cerr << "каскад не нашёл объект " << object.width << "x" << object.height << std::endl;
+			return 1;
+		}
+	}
+	for (int i = 0; i < found.getLength(); ++i) {
+		if (!Covers(found.Getrvalue(i), objects[0]) && !Covers(found.Getrvalue(i), objects[1])) {
+			std::cerr << "ложное срабатывание каскада" << std::endl;
+			return 1;
+		}
+	}
+
+	CCTV::ThreadPool pool(4);
+	std::vector<unsigned char> busy = MakeScene(320, 200, {{10, 10, 24, 24}, {100, 40, 30, 30}, {200, 90, 60, 60}, {37, 150, 37, 37}});
+	CCTV::IntegralImage busyImage = CCTV::Frame(320, 200, 3, busy.data()).GetIntegralImage();
+	CCTV::HaarDetectParams dense;
+	dense.stepFraction = 0.02f;
+	ForceSimdLevel(SimdLevel::Scalar);
+	PATypes::MutableArraySequence<CCTV::Detection> serial = cascade.Detect(busyImage, dense);
+	ForceSimdLevel(DetectSimdLevel());
+	PATypes::MutableArraySequence<CCTV::Detection> parallel = cascade.Detect(busyImage, dense, &pool);
+	bool same = serial.getLength() == parallel.getLength() && serial.getLength() > 0;
+	for (int i = 0; same && i < serial.getLength(); ++i) {
+		const CCTV::Detection &a = serial.Getrvalue(i), &b = parallel.Getrvalue(i);
+		same = a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+	}
+	if (!same) {
+		std::cerr << "параллельный поиск " << GetSimdLevelName(GetSimdLevel()) << " разошёлся с последовательным scalar" << std::endl;
+		return 1;
+	}
+
+	std::vector<unsigned char> empty = MakeScene(240, 135, {});
+	CCTV::Frame frames[] = {CCTV::Frame(240, 135, 3, empty.data()), frame};
+	CCTV::FrameSequence sequence(frames, 2, 2);
+	if (sequence.TagObjects(cascade) != 1 || sequence.Getrvalue(0).GetTag() || sequence.Getrvalue(1).GetTag()->GetName() != "Объект") {
+		std::cerr << "метка объекта поставлена неверно" << std::endl;
+		return 1;
+	}
 
-}
\ No newline at end of file
+	std::vector<unsigned char> large = MakeScene(1920, 1080, {{600, 400, 96, 96}});
+	CCTV::Frame fullHD(1920, 1080, 3, large.data());
+	CCTV::IntegralImage fullImage = fullHD.GetIntegralImage();
+	long long windows = cascade.CountWindows(1920, 1080);
+	double sink = 0;
+	double integralMs = Measure(10, [&] { sink += fullHD.GetIntegralImage().GetWidth(); });
+	double detectMs = Measure(3, [&] { sink += cascade.Detect(fullImage).getLength(); });
+	std::cout << "1920x1080, " << GetSimdLevelName(GetSimdLevel()) << ": интегральное изображение " << integralMs << " мс, каскад " << detectMs << " мс, " << windows / detectMs * 1000 << " окон/с" << std::endl;
+	return sink < 0;
+}
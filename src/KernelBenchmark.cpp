@@ -0,0 +1,100 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "Frame.hpp"
+
+using namespace CCTV::PixelKernels;
+
+template <class F> static double Measure(int iterations, F &&f) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i) {
+		f();
+	}
+	std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+int main(int argc, char **argv) {
+	const int width = 1920, height = 1080, channels = 3, iterations = 50;
+	std::vector<unsigned char> pixelsA(width * height * channels), pixelsB(width * height * channels);
+	for (size_t i = 0; i < pixelsA.size(); ++i) {
+		pixelsA[i] = (unsigned char)(i * 31 + (i >> 7));
+		pixelsB[i] = (unsigned char)(i * 17 + (i >> 5));
+	}
+	CCTV::Frame a(width, height, channels, pixelsA.data()), b(width, height, channels, pixelsB.data());
+
+	std::vector<SimdLevel> levels;
+	if (argc > 1) {
+		levels.push_back(ParseSimdLevel(argv[1]));
+	} else {
+		levels = {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512BW};
+	}
+
+	std::cout << "Кадр " << width << "x" << height << "x" << channels << ", мс на операцию" << std::endl;
+	std::cout << "уровень\tMeanAbsDiff\tdelta\tXOR\tAND\tnorm" << std::endl;
+	double sink = 0;
+	for (SimdLevel level : levels) {
+		if (!IsSimdLevelSupported(level)) {
+			std::cout << GetSimdLevelName(level) << "\tне поддерживается" << std::endl;
+			continue;
+		}
+		ForceSimdLevel(level);
+		std::cout << GetSimdLevelName(level);
+		std::cout << "\t" << Measure(iterations, [&] { sink += a.MeanAbsDiff(b); });
+		std::cout << "\t" << Measure(iterations, [&] { sink += a.delta(b).GetWidth(); });
+		std::cout << "\t" << Measure(iterations, [&] { sink += a.XOR(b).GetWidth(); });
+		std::cout << "\t" << Measure(iterations, [&] { sink += a.AND(b).GetWidth(); });
+		std::cout << "\t" << Measure(iterations, [&] { sink += a.norm(); });
+		std::cout << std::endl;
+	}
+
+	std::cout << "Гистограммы, мс на кадр" << std::endl;
+	std::cout << "яркость	каналы	RGB 16^3" << std::endl;
+	std::cout << Measure(iterations, [&] { sink += a.GetLumaHistogram().bins[0]; });
+	std::cout << "	" << Measure(iterations, [&] { sink += a.GetChannelHistograms().channel[0].bins[0]; });
+	std::cout << "	" << Measure(iterations, [&] { sink += a.GetQuantizedRGBHistogram().bins[0]; });
+	std::cout << std::endl;
+	// как кадр от декодера с DecodeFormat::Luma и масштабом анализа 1/2
+	CCTV::Frame lumaHalf(width / 2, height / 2, 1, pixelsA.data());
+	std::cout << "яркость, кадр Y " << width / 2 << "x" << height / 2 << ": "
+			  << Measure(iterations, [&] { sink += lumaHalf.GetLumaHistogram().bins[0]; }) << std::endl;
+
+	std::cout << "Плитки 32x32, мс на пару кадров" << std::endl;
+	std::cout << "TileDelta	MeanAbsDiff" << std::endl;
+	std::cout << Measure(iterations, [&] { sink += a.TileDelta(b).GetMaxTileScore(); });
+	std::cout << "	" << Measure(iterations, [&] { sink += a.MeanAbsDiff(b); });
+	std::cout << std::endl;
+
+	// левые 70% кадра и полоса сверху исключены, как деревья и дорога
+	CCTV::RegionMask mask(width, height);
+	mask.Exclude(0, 0, width * 7 / 10, height);
+	mask.Exclude(0, 0, width, height / 10);
+	std::cout << "Маска " << mask.GetCoverage() * 100 << "% кадра, мс на пару кадров" << std::endl;
+	std::cout << "MeanAbsDiff	гистограмма	TileDelta" << std::endl;
+	std::cout << Measure(iterations, [&] { sink += a.MeanAbsDiff(b, mask); });
+	std::cout << "	" << Measure(iterations, [&] { sink += a.GetLumaHistogram(mask).bins[0]; });
+	std::cout << "	" << Measure(iterations, [&] { sink += a.TileDelta(b, 32, &mask).GetMaxTileScore(); });
+	std::cout << std::endl;
+
+	// прежний фон — цепочка AND по окну, кадр на каждый шаг
+	std::cout << "Фон, мс на кадр" << std::endl;
+	std::cout << "окно	AND	среднее	медиана" << std::endl;
+	for (int window : {4, 16, 64}) {
+		std::cout << window << "	" << Measure(iterations / 10, [&] {
+			CCTV::Frame background = a;
+			for (int i = 1; i < window; ++i) {
+				background = background.AND(i % 2 ? b : a);
+			}
+			sink += a.MeanAbsDiff(background);
+		});
+		for (CCTV::BackgroundKind kind : {CCTV::BackgroundKind::RunningAverage, CCTV::BackgroundKind::RunningMedian}) {
+			CCTV::BackgroundModel model(kind, window);
+			model.Update(a.GetData(), width, height, channels);
+			int i = 0;
+			std::cout << "	" << Measure(iterations, [&] { sink += model.Update((++i % 2 ? b : a).GetData(), width, height, channels); });
+		}
+		std::cout << std::endl;
+	}
+	return sink < 0;
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+
+#include <PATypes/FlatHashMap.h>
+#include <PATypes/HashMap.h>
+
+// Ключи различны и разбросаны, как индексы кадров после фильтрации
+static int KeyAt(int i) { return (int)((unsigned)i * 2654435761u >> 1); }
+
+template <class F> static double NanosecondsPerOp(int operations, F &&f) {
+	auto start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+	return elapsed.count() / operations;
+}
+
+// Промах так, как его обрабатывал кэш оценок FrameSequence: через исключение
+template <class K, class V> static bool Lookup(PATypes::HashMap<K, V> &map, const K &key, V &value) {
+	try {
+		value = map.Get(key);
+		return true;
+	} catch (std::out_of_range &) {
+		return false;
+	}
+}
+
+template <class K, class V> static bool Lookup(PATypes::FlatHashMap<K, V> &map, const K &key, V &value) {
+	return map.TryGet(key, value);
+}
+
+template <class M> static void Run(const char *name, M &map, int keys, int lookups) {
+	long long sink = 0;
+	double insert = NanosecondsPerOp(keys, [&] {
+		for (int i = 0; i < keys; ++i) {
+			map.Add(KeyAt(i), i);
+		}
+	});
+	double hit = NanosecondsPerOp(lookups, [&] {
+		for (int i = 0; i < lookups; ++i) {
+			sink += map.Get(KeyAt((int)((long long)i * keys / lookups)));
+		}
+	});
+	double miss = NanosecondsPerOp(lookups, [&] {
+		for (int i = 0; i < lookups; ++i) {
+			int value;
+			sink += Lookup(map, KeyAt(keys + i), value) ? value : -1;
+		}
+	});
+	std::cout << name << "\t" << keys << "\t" << insert << "\t" << hit << "\t" << miss << "\t" << (sink == 42) << std::endl;
+}
+
+int main(int argc, char **argv) {
+	int maxKeys = argc > 1 ? std::atoi(argv[1]) : 10000000;
+	std::cout << "нс на операцию; промах в HashMap — исключение, в FlatHashMap — TryGet" << std::endl;
+	std::cout << "карта\tключей\tвставка\tпопадание\tпромах" << std::endl;
+	for (int keys : {1000, 100000, 10000000}) {
+		if (keys > maxKeys)
+			break;
+		int lookups = std::min(keys, 1000000);
+		{
+			PATypes::FlatHashMap<int, int> flat;
+			Run("FlatHashMap", flat, keys, lookups);
+		}
+		{
+			// С HASHMAP_MOD = 1024 корзин на 10M ключей цепочки длиной ~10^4
+			// и вставка квадратична — цепочную карту заранее делаем на
+			// keys корзин, иначе замер не закончится
+			size_t mod = keys > 100000 ? (size_t)keys : HASHMAP_MOD;
+			PATypes::HashMap<int, int> chained(mod);
+			Run(mod == HASHMAP_MOD ? "HashMap" : "HashMap(mod=keys)", chained, keys, lookups);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "Frame.hpp"
+
+using namespace CCTV::PixelKernels;
+
+static const int frameCount = 60;
+// объект появляется на этом кадре и остаётся
+static const int arrival = 50;
+
+// Статичная сцена с шумом сенсора; левая треть кадра — листва, которая
+// качается между двумя положениями с периодом в три кадра
+static CCTV::Frame MakeFrame(int index, int width, int height) {
+	CCTV::Frame frame(width, height, 3);
+	unsigned char *pixels = frame.GetMutableData();
+	uint32_t seed = index * 2654435761u;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int value = 100 + (x * 7 + y * 13) % 32;
+			if (x < width / 3)
+				value = ((x / 24 + y / 24 + index / 3) % 2) ? 60 : 150;
+			if (index >= arrival && x >= 1200 && x < 1400 && y >= 400 && y < 700)
+				value = 20;
+			for (int c = 0; c < 3; ++c) {
+				seed = seed * 1664525u + 1013904223u;
+				int noisy = value + (int)(seed >> 29) - 4;
+				pixels[(y * width + x) * 3 + c] = std::clamp(noisy, 0, 255);
+			}
+		}
+	}
+	return frame;
+}
+
+int main() {
+	const int width = 1920, height = 1080;
+	std::vector<CCTV::Frame> frames;
+	for (int i = 0; i < frameCount; ++i) {
+		frames.push_back(MakeFrame(i, width, height));
+	}
+
+	std::cout << "Кадры " << width << "x" << height << "x3, " << frameCount << " кадров, объект с кадра " << arrival << ", "
+			  << GetSimdLevelName(GetSimdLevel()) << ", ядер " << CCTV::ThreadPool::GetDefaultThreadCount() << std::endl;
+	std::cout << "потоки\tмс/кадр\tкадр/с\tдо объекта\tс объектом" << std::endl;
+	double sink = 0;
+	for (int threads : {1, 2, 4}) {
+		CCTV::ThreadPool pool(threads);
+		CCTV::MixtureParams params;
+		params.learningRate = 0.05f;
+		CCTV::MixtureModel model(params);
+		double before = 0, after = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < frameCount; ++i) {
+			double score = model.Update(frames[i].GetData(), width, height, 3, nullptr, &pool);
+			if (i == arrival - 1)
+				before = score;
+			if (i == arrival)
+				after = score;
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		double perFrame = elapsed.count() / frameCount;
+		std::cout << threads << "\t" << perFrame << "\t" << 1000 / perFrame << "\t" << before << "\t" << after << std::endl;
+		sink += after;
+	}
+
+	// разность соседних кадров на той же сцене: листва даёт оценку не
+	// меньше, чем появление объекта
+	CCTV::FrameSequence delta(frames.data(), frameCount, 2);
+	std::cout << "разность пикселей: до объекта " << delta.GetScore(arrival - 1) << ", с объектом " << delta.GetScore(arrival) << std::endl;
+	return sink < 0;
+}
@@ -0,0 +1,104 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "Frame.hpp"
+
+using namespace CCTV::PixelKernels;
+
+// Событие сцены: квадрат на кадрах [from, from + length). cell — размер
+// клетки шахматной раскраски, 0 — сплошной тёмный квадрат
+struct Event {
+	int from, length, x, y, size, cell;
+};
+
+static const Event events[] = {
+	{5, 3, 200, 150, 256, 0},
+	{12, 3, 900, 300, 384, 2},
+	{19, 3, 1200, 400, 512, 0},
+	{26, 3, 300, 500, 512, 4},
+};
+static const int frameCount = 32;
+
+// Текстурный фон, шум сенсора свой на каждом кадре
+static CCTV::Frame MakeFrame(int index, int width, int height) {
+	CCTV::Frame frame(width, height, 3);
+	unsigned char *pixels = frame.GetMutableData();
+	uint32_t seed = index * 2654435761u;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int value = 100 + (x * 7 + y * 13) % 32;
+			for (const Event &event : events) {
+				if (index < event.from || index >= event.from + event.length)
+					continue;
+				if (x < event.x || x >= event.x + event.size || y < event.y || y >= event.y + event.size)
+					continue;
+				value = event.cell ? ((x / event.cell + y / event.cell) % 2) * 255 : 20;
+			}
+			for (int c = 0; c < 3; ++c) {
+				seed = seed * 1664525u + 1013904223u;
+				int noisy = value + (int)(seed >> 29) - 4;
+				pixels[(y * width + x) * 3 + c] = std::clamp(noisy, 0, 255);
+			}
+		}
+	}
+	return frame;
+}
+
+// Кадр r меняется относительно r - 1: появление или исчезновение объекта
+static bool IsEventFrame(int r) {
+	for (const Event &event : events) {
+		if (r == event.from || r == event.from + event.length)
+			return true;
+	}
+	return false;
+}
+
+int main() {
+	const int width = 1920, height = 1080;
+	// над шумом кадра без событий, в тех же единицах, что оценка
+	const float margin = 3.0f;
+	int eventCount = 0;
+	for (int r = 1; r < frameCount; ++r) {
+		eventCount += IsEventFrame(r);
+	}
+
+	std::cout << "Кадры " << width << "x" << height << "x3, " << frameCount << " кадров, " << eventCount << " событий, "
+			  << GetSimdLevelName(GetSimdLevel()) << ", один поток" << std::endl;
+	std::cout << "оценка\tмасштаб\tмс/кадр\tкадр/с\tшум\tполнота\tлишние" << std::endl;
+	double sink = 0;
+	for (CCTV::ScoreMode mode : {CCTV::ScoreMode::PixelDelta, CCTV::ScoreMode::LumaHistogram}) {
+		for (int scale : {1, 2, 4, 8}) {
+			// кадры заново на каждый масштаб, чтобы время включало пирамиду
+			CCTV::FrameSequence frames(2, 0, 1e9f);
+			for (int i = 0; i < frameCount; ++i) {
+				frames.append(MakeFrame(i, width, height));
+			}
+			frames.SetPrecalcThreads(1);
+			frames.SetScoreMode(mode);
+			frames.SetAnalysisScale(scale);
+			auto start = std::chrono::steady_clock::now();
+			// порог — шум кадра без событий плюс margin: при уменьшении шум
+			// усредняется, и общий порог сравнивал бы не потерю деталей, а шум
+			double noise = frames.GetScore(2);
+			frames.SetTreshold(noise + margin);
+			frames.PrecalcScore();
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+			int found = 0, extra = 0;
+			auto tags = frames.GetTagEnumerator();
+			while (tags->moveNext()) {
+				if (IsEventFrame(tags->current().getFirst()))
+					++found;
+				else
+					++extra;
+			}
+			delete tags;
+			double perFrame = elapsed.count() / frameCount;
+			std::cout << CCTV::GetScoreModeName(mode) << "\t1/" << scale << "\t" << perFrame << "\t" << 1000 / perFrame << "\t" << noise
+					  << "\t" << (double)found / eventCount << "\t" << extra << std::endl;
+			sink += found;
+		}
+	}
+	return sink < 0;
+}
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <bit>
 #include <iostream>
 #include <string>
 
@@ -19,17 +20,21 @@ extern "C" {
 #include <portable-file-dialogs.h>
 
 #include "Frame.hpp"
+#include "PrecalcJob.hpp"
+#include "TextureCache.hpp"
+#include "VideoLoader.hpp"
 #include <PATypes/Sequence.h>
 
 static std::string currentError;
 static bool errorPopupOpen = 0;
 
-static CCTV::FrameSequence OpenFrameSequence() {
+// Загрузка идёт в фоне, кадры забирает VideoLoader::Collect
+static std::unique_ptr<CCTV::VideoLoader> OpenVideo(CCTV::DecodeFormat format) {
     try {
         std::vector<std::string> result =
             pfd::open_file("Открыть видеофайл", "", {"*"}).result();
         if (result.size() > 0)
-            return CCTV::FrameSequence::LoadFromVideo(result[0], 0);
+            return std::make_unique<CCTV::VideoLoader>(result[0], 0, format);
         else
             throw std::invalid_argument("Пользователь не выбрал файл");
     } catch (const std::invalid_argument &e) {
@@ -59,10 +64,36 @@ static void DisplayEvents(CCTV::FrameSequence &frames, int &currentIndex) {
     ImGui::EndChild();
 }
 
+// Сетка плиток поверх кадра, занимающего на экране [min, max]: чем
+// сильнее плитка изменилась относительно предыдущего кадра, тем плотнее
+// красная заливка; при оценке плитки saturation заливка максимальна
+static void DrawTileHeatmap(const CCTV::TileGrid &grid, ImVec2 min, ImVec2 max,
+                            float saturation) {
+    if (!grid.GetWidth() || !grid.GetHeight())
+        return;
+    ImDrawList *dl = ImGui::GetWindowDrawList();
+    const float sx = (max.x - min.x) / grid.GetWidth();
+    const float sy = (max.y - min.y) / grid.GetHeight();
+    const int tile = grid.GetTileSize();
+    for (int row = 0; row < grid.GetRows(); ++row) {
+        for (int column = 0; column < grid.GetColumns(); ++column) {
+            const float t = std::clamp(
+                (float)grid.GetTileScore(column, row) / saturation, 0.0f, 1.0f);
+            if (t < 0.05f)
+                continue;
+            ImVec2 from(min.x + column * tile * sx, min.y + row * tile * sy);
+            ImVec2 to(min.x + std::min(grid.GetWidth(), (column + 1) * tile) * sx,
+                      min.y + std::min(grid.GetHeight(), (row + 1) * tile) * sy);
+            dl->AddRectFilled(from, to, IM_COL32(255, 40, 40, (int)(160 * t)));
+        }
+    }
+}
+
 static void DrawFrameSequenceTimeline(const char *id,
                                       CCTV::FrameSequence &frames,
                                       int &currentIndex, bool &playing,
-                                      float &fps, float &zoomPxPerFrame) {
+                                      float &fps, float &zoomPxPerFrame,
+                                      std::unique_ptr<CCTV::PrecalcJob> &precalc) {
     const int n = frames.getLength();
     if (n <= 0) {
         ImGui::TextUnformatted("Последовательность кадров пуста.");
@@ -71,6 +102,11 @@ static void DrawFrameSequenceTimeline(const char *id,
 
     float treshold = frames.GetTreshold();
     float leapTreshold = frames.GetLeapTreshold();
+    float flashTreshold = frames.GetFlashTreshold();
+    int scoreMode = (int)frames.GetScoreMode();
+    int histogramMetric = (int)frames.GetHistogramMetric();
+    // 0 — полный размер, 1 — 1/2, 2 — 1/4, 3 — 1/8
+    int analysisLevel = std::countr_zero((unsigned)frames.GetAnalysisScale());
 
     currentIndex = std::clamp(currentIndex, 0, n - 1);
 
@@ -99,12 +135,58 @@ static void DrawFrameSequenceTimeline(const char *id,
     ImGui::SliderInt("Размер окна", &windowLength, 0, frames.getLength());
     ImGui::SliderFloat("Порог значимости", &treshold, 0, 2000.f, "%.1f");
     ImGui::SliderFloat("Порог скачка", &leapTreshold, 0, 1000.f, "%.1f");
+    const char *scoreModes[] = {
+        CCTV::GetScoreModeName(CCTV::ScoreMode::PixelDelta),
+        CCTV::GetScoreModeName(CCTV::ScoreMode::LumaHistogram),
+        CCTV::GetScoreModeName(CCTV::ScoreMode::Tiles),
+        CCTV::GetScoreModeName(CCTV::ScoreMode::BackgroundAverage),
+        CCTV::GetScoreModeName(CCTV::ScoreMode::BackgroundMedian),
+        CCTV::GetScoreModeName(CCTV::ScoreMode::Mixture)};
+    ImGui::Combo("Оценка", &scoreMode, scoreModes, IM_ARRAYSIZE(scoreModes));
+    if (scoreMode == (int)CCTV::ScoreMode::LumaHistogram) {
+        const char *metrics[] = {
+            CCTV::GetHistogramMetricName(CCTV::HistogramMetric::ChiSquare),
+            CCTV::GetHistogramMetricName(CCTV::HistogramMetric::Bhattacharyya),
+            CCTV::GetHistogramMetricName(CCTV::HistogramMetric::EarthMovers)};
+        ImGui::Combo("Метрика", &histogramMetric, metrics,
+                     IM_ARRAYSIZE(metrics));
+        ImGui::SliderFloat("Порог вспышки", &flashTreshold, 0, 255.f, "%.1f");
+    }
+    const char *analysisScales[] = {"1", "1/2", "1/4", "1/8"};
+    ImGui::Combo("Масштаб анализа", &analysisLevel, analysisScales,
+                 IM_ARRAYSIZE(analysisScales));
+    frames.SetAnalysisScale(1 << analysisLevel);
+    frames.SetScoreMode((CCTV::ScoreMode)scoreMode,
+                        (CCTV::HistogramMetric)histogramMetric);
+    frames.SetFlashTreshold(flashTreshold);
     frames.SetWindow(windowLength);
     frames.SetFramerate(fps);
     frames.SetTreshold(treshold);
     frames.SetLeapTreshold(leapTreshold);
-    if (ImGui::Button("Предпосчитать")) {
-        frames.PrecalcScore();
+
+    try {
+        if (precalc && !precalc->Matches(frames)) {
+            // параметры сменились — начинаем заново, уже посчитанные дельты
+            // пар переходят в новый расчёт
+            precalc->Stop(frames);
+            precalc = std::make_unique<CCTV::PrecalcJob>(frames);
+        } else if (precalc && precalc->Collect(frames)) {
+            precalc.reset();
+        }
+    } catch (const std::exception &e) {
+        precalc.reset();
+        currentError = std::string(e.what());
+        errorPopupOpen = true;
+    }
+    if (precalc) {
+        ImGui::ProgressBar(precalc->GetProgress(), ImVec2(200.0f, 0.0f));
+        ImGui::SameLine();
+        if (ImGui::Button("Отмена")) {
+            precalc->Stop(frames);
+            precalc.reset();
+        }
+    } else if (ImGui::Button("Предпосчитать")) {
+        precalc = std::make_unique<CCTV::PrecalcJob>(frames);
     }
 
     static float playAccum = 0.0f;
@@ -126,6 +208,10 @@ static void DrawFrameSequenceTimeline(const char *id,
     const float totalW = n * w;
 
     ImGui::Text("Кадры: %d", n);
+    if (frames.GetDecodeThreads() > 0) {
+        ImGui::SameLine();
+        ImGui::Text("Потоков декодирования: %d", frames.GetDecodeThreads());
+    }
 
     ImGui::BeginChild(id, ImVec2(0, canvasH), ImGuiChildFlags_Borders,
                       ImGuiWindowFlags_HorizontalScrollbar);
@@ -147,6 +233,14 @@ static void DrawFrameSequenceTimeline(const char *id,
         ImU32 col = IM_COL32((60 + 160), (60 + 160), (60 + 160), 255);
         ImU32 border = IM_COL32(60, 60, 60, 255);
 
+        // посчитанные кадры темнеют к красному по мере роста оценки
+        if (frames.HasScore(i) && treshold > 0) {
+            const float t =
+                std::clamp((float)frames.GetScore(i) / treshold, 0.0f, 1.0f);
+            col = IM_COL32(220, (int)(220 - 160 * t), (int)(220 - 160 * t),
+                           255);
+        }
+
         if (i == currentIndex) {
             col = IM_COL32(90, 140, 220, 255);
             border = IM_COL32(220, 220, 220, 255);
@@ -169,10 +263,15 @@ static void DrawFrameSequenceTimeline(const char *id,
         const float mx = ImGui::GetIO().MousePos.x - baseX;
         const int idx = (int)std::floor(mx / w);
         if (frames.GetWindow() <= idx && idx < n) {
-            float score = frames.GetScore(idx);
+            // в режимах фона оценка далёкого кадра — прогон модели с
+            // начала, его делает только PrecalcJob
+            std::optional<double> score = frames.TryGetScore(idx);
             ImGui::BeginTooltip();
             ImGui::Text("Кадр: %d", idx);
-            ImGui::Text("Важность : %.3f", score);
+            if (score)
+                ImGui::Text("Важность : %.3f", *score);
+            else
+                ImGui::TextUnformatted("Важность : не посчитана");
             ImGui::EndTooltip();
         }
     }
@@ -225,11 +324,31 @@ int main(int argc, char **argv) {
     }
 
     CCTV::FrameSequence frames(30);
+    auto textureCache = std::make_unique<CCTV::FrameTextureCache>();
+    std::unique_ptr<CCTV::PrecalcJob> precalc;
+    std::unique_ptr<CCTV::VideoLoader> loader;
 
     int currentIndex = 0;
     bool playing = false;
     float fps = frames.GetFramerate();
     float zoom = 10.0f;
+    // кадры только из яркости: быстрее, но просмотр серый
+    bool lumaOnly = false;
+    // изменения по плиткам поверх кадра
+    bool showHeatmap = false;
+    float heatmapSaturation = 32.0f;
+
+    auto openVideo = [&] {
+        std::unique_ptr<CCTV::VideoLoader> opened =
+            OpenVideo(lumaOnly ? CCTV::DecodeFormat::Luma
+                               : CCTV::DecodeFormat::RGB);
+        precalc.reset();
+        loader = std::move(opened);
+        frames = loader->CreateSequence(0);
+        fps = frames.GetFramerate();
+        currentIndex = 0;
+        textureCache->Invalidate();
+    };
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -286,14 +405,14 @@ int main(int argc, char **argv) {
             if (ImGui::BeginMenu("Файл")) {
                 if (ImGui::MenuItem("Открыть...", "Ctrl+O")) {
                     try {
-                        frames = OpenFrameSequence();
-                        fps = frames.GetFramerate();
+                        openVideo();
                     } catch (const std::invalid_argument &e) {
                     } catch (const std::runtime_error &e) {
                         currentError = std::string(e.what());
                         errorPopupOpen = true;
                     }
                 }
+                ImGui::MenuItem("Только яркость", nullptr, &lumaOnly);
                 if (ImGui::MenuItem("Выйти", "Ctrl+Q")) {
                     done = true;
                 }
@@ -305,8 +424,11 @@ int main(int argc, char **argv) {
         if (ImGui::Shortcut(ImGuiMod_Ctrl | ImGuiKey_O,
                             ImGuiInputFlags_RouteGlobal)) {
             try {
-                frames = OpenFrameSequence();
-            } catch (std::invalid_argument&) {
+                openVideo();
+            } catch (const std::invalid_argument &e) {
+            } catch (const std::runtime_error &e) {
+                currentError = std::string(e.what());
+                errorPopupOpen = true;
             }
         }
 
@@ -315,6 +437,39 @@ int main(int argc, char **argv) {
             done = true;
         }
 
+        if (loader) {
+            try {
+                // не больше 8 мс на кадр интерфейса
+                loader->Collect(frames, std::chrono::milliseconds(8));
+            } catch (const std::exception &e) {
+                loader.reset();
+                currentError = std::string(e.what());
+                errorPopupOpen = true;
+            }
+        }
+        if (loader) {
+            if (ImGui::Begin("Загрузка видео", nullptr,
+                             ImGuiWindowFlags_AlwaysAutoResize)) {
+                float progress = loader->GetProgress();
+                if (progress >= 0) {
+                    ImGui::ProgressBar(progress, ImVec2(200.0f, 0.0f));
+                    ImGui::SameLine();
+                }
+                ImGui::Text("Кадров: %d, %.1f к/с", loader->GetFrameCount(),
+                            loader->GetFramesPerSecond());
+                if (loader->IsFinished()) {
+                    if (ImGui::Button("Закрыть"))
+                        loader.reset();
+                } else if (ImGui::Button("Отмена")) {
+                    // уже загруженные кадры остаются
+                    loader.reset();
+                }
+                ImGui::End();
+            } else {
+                ImGui::End();
+            }
+        }
+
         if (ImGui::Begin("События")) {
             DisplayEvents(frames, currentIndex);
             ImGui::End();
@@ -324,26 +479,48 @@ int main(int argc, char **argv) {
 
         if (ImGui::Begin("Таймлайн")) {
             DrawFrameSequenceTimeline("frames_timeline", frames, currentIndex,
-                                      playing, fps, zoom);
+                                      playing, fps, zoom, precalc);
             ImGui::End();
         } else {
             ImGui::End();
         }
 
-        std::shared_ptr<CCTV::IGLTexture> texture;
         if (ImGui::Begin("Просмотр кадра", nullptr,
                          ImGuiWindowFlags_AlwaysAutoResize)) {
             if (frames.getLength() > 0) {
-                CCTV::Frame frame = frames.get(currentIndex);
-                texture = frame.GetTexture();
+                const CCTV::Frame &frame = frames.Getrvalue(currentIndex);
+                textureCache->Show(frame, currentIndex, playing);
 
                 ImGui::Text("Кадр: %d/ %d", currentIndex + 1,
                             frames.getLength());
 
-                if (texture) {
-                    ImGui::Image((ImTextureID)(intptr_t)texture->GetTexture(),
-                                 ImVec2((float)frame.GetWidth(),
-                                        (float)frame.GetHeight()));
+                ImGui::SameLine();
+                ImGui::Checkbox("Тепловая карта", &showHeatmap);
+                if (showHeatmap) {
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(150.0f);
+                    ImGui::SliderFloat("Насыщение", &heatmapSaturation, 1.0f,
+                                       255.0f, "%.0f");
+                }
+
+                if (textureCache->GetIndex() == currentIndex) {
+                    ImGui::Image(
+                        (ImTextureID)(intptr_t)textureCache->GetTexture(),
+                        ImVec2((float)frame.GetWidth(),
+                               (float)frame.GetHeight()));
+                    if (showHeatmap) {
+                        try {
+                            if (std::shared_ptr<const CCTV::TileGrid> grid =
+                                    frames.GetTileGrid(currentIndex))
+                                DrawTileHeatmap(*grid, ImGui::GetItemRectMin(),
+                                                ImGui::GetItemRectMax(),
+                                                heatmapSaturation);
+                        } catch (const std::exception &e) {
+                            showHeatmap = false;
+                            currentError = std::string(e.what());
+                            errorPopupOpen = true;
+                        }
+                    }
                 } else {
                     ImGui::TextUnformatted("Текстура не подгружена.");
                 }
@@ -364,6 +541,7 @@ int main(int argc, char **argv) {
         SDL_GL_SwapWindow(window);
     }
 
+    textureCache.reset();
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplSDL2_Shutdown();
     ImGui::DestroyContext();